@@ -1,4 +1,5 @@
 include(CMakeFindDependencyMacro)
 find_dependency(ICU COMPONENTS uc data)
 find_dependency(Boost 1.62.0)
+find_dependency(Threads)
 include("${CMAKE_CURRENT_LIST_DIR}/NuspellTargets.cmake")
@@ -19,10 +19,16 @@
 #include "aff_data.hxx"
 #include "utils.hxx"
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 
+#include <boost/locale/utf.hpp>
+
 /*
  * Aff_Data class and the method parse() should be structured in the following
  * way. The data members of the class should be data structures that are
@@ -89,6 +95,66 @@ auto Encoding::normalize_name() -> void
 		name.erase(0, 10);
 }
 
+auto Flag_Id_Map::enable() -> void
+{
+	if (enabled())
+		return;
+	unknown_id = next_id++;
+	// Dict_Base::calc_syllable_modifier() tests these flags by value.
+	for (auto f : u"IJc")
+		if (f)
+			insert(f);
+}
+
+auto Flag_Id_Map::insert(char16_t flag) -> char16_t
+{
+	if (!enabled())
+		return flag;
+	auto [it, inserted] = ids.emplace(flag, next_id);
+	if (inserted) {
+		// ids never collide with the operators of compound rules
+		do
+			++next_id;
+		while (next_id == u'*' || next_id == u'?');
+	}
+	return it->second;
+}
+
+auto Flag_Id_Map::insert(std::u16string& flags) -> void
+{
+	if (!enabled())
+		return;
+	for (auto& f : flags)
+		f = insert(f);
+}
+
+auto Flag_Id_Map::insert_compound_rule(std::u16string& rule) -> void
+{
+	if (!enabled())
+		return;
+	for (auto& f : rule)
+		if (f != u'*' && f != u'?')
+			f = insert(f);
+}
+
+auto Flag_Id_Map::find(char16_t flag) const -> char16_t
+{
+	if (!enabled())
+		return flag;
+	auto it = ids.find(flag);
+	if (it == end(ids))
+		return unknown_id;
+	return it->second;
+}
+
+auto Flag_Id_Map::find(std::u16string& flags) const -> void
+{
+	if (!enabled())
+		return;
+	for (auto& f : flags)
+		f = find(f);
+}
+
 namespace {
 
 void reset_failbit_istream(std::istream& in)
@@ -193,17 +259,11 @@ auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
 	return warn;
 }
 
-auto decode_flags_possible_alias(const string& s, Flag_Type t,
-                                 const Encoding& enc,
-                                 const vector<Flag_Set>& flag_aliases,
-                                 u16string& out) -> Parsing_Error_Code
+auto decode_alias_index(const string& s, size_t num_aliases, size_t& out)
+    -> Parsing_Error_Code
 {
-	if (flag_aliases.empty())
-		return decode_flags(s, t, enc, out);
-
 	char* p;
 	errno = 0;
-	out.clear();
 	auto i = strtoul(s.c_str(), &p, 10);
 	if (p == s.c_str())
 		return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
@@ -211,13 +271,29 @@ auto decode_flags_possible_alias(const string& s, Flag_Type t,
 	if (i == numeric_limits<decltype(i)>::max() && errno == ERANGE)
 		return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
 
-	if (0 < i && i <= flag_aliases.size()) {
-		out = flag_aliases[i - 1];
+	if (0 < i && i <= num_aliases) {
+		out = i - 1;
 		return {};
 	}
 	return Parsing_Error_Code::INVALID_NUMERIC_ALIAS;
 }
 
+auto decode_flags_possible_alias(const string& s, Flag_Type t,
+                                 const Encoding& enc,
+                                 const vector<Flag_Set>& flag_aliases,
+                                 u16string& out) -> Parsing_Error_Code
+{
+	if (flag_aliases.empty())
+		return decode_flags(s, t, enc, out);
+
+	out.clear();
+	size_t i;
+	auto err = decode_alias_index(s, flag_aliases.size(), i);
+	if (err == Parsing_Error_Code{})
+		out = flag_aliases[i];
+	return err;
+}
+
 auto report_parsing_error(Parsing_Error_Code err, size_t line_num)
 {
 	using Err = Parsing_Error_Code;
@@ -372,7 +448,7 @@ class Aff_Line_Stream : public std::istringstream {
 	std::string str_buf;
 	std::u16string flag_buffer;
 
-	const Aff_Data* aff_data = nullptr;
+	Aff_Data* aff_data = nullptr;
 	Encoding_Converter cvt;
 
 	auto virtual dummy_func() -> void;
@@ -446,6 +522,8 @@ class Aff_Line_Stream : public std::istringstream {
 			if (in.exceptions() & in.failbit)
 				throw failure("unknown FLAG type");
 		}
+		if (flag_type != Ft::SINGLE_CHAR)
+			aff_data->flag_ids.enable();
 		return in;
 	}
 
@@ -472,6 +550,7 @@ class Aff_Line_Stream : public std::istringstream {
 			return in;
 		err = decode_flags(str_buf, aff_data->flag_type,
 		                   aff_data->encoding, flags);
+		aff_data->flag_ids.insert(flags);
 		if (static_cast<int>(err) > 0) {
 			in.setstate(in.failbit);
 			if (in.exceptions() & in.failbit)
@@ -515,6 +594,8 @@ class Aff_Line_Stream : public std::istringstream {
 			err = decode_flags_possible_alias(
 			    flag_str, aff_data->flag_type, aff_data->encoding,
 			    aff_data->flag_aliases, flag_buffer);
+			if (aff_data->flag_aliases.empty())
+				aff_data->flag_ids.insert(flag_buffer);
 			if (err == Err::MISSING_FLAGS)
 				err = Err::NO_FLAGS_AFTER_SLASH_WARNING;
 			flags = flag_buffer;
@@ -574,6 +655,7 @@ class Aff_Line_Stream : public std::istringstream {
 			str_buf.erase(slash_pos);
 			err = decode_flags(flag_str, aff_data->flag_type,
 			                   aff_data->encoding, flag_buffer);
+			aff_data->flag_ids.insert(flag_buffer);
 			if (!flag_buffer.empty())
 				flag = flag_buffer[0];
 		}
@@ -605,6 +687,7 @@ class Aff_Line_Stream : public std::istringstream {
 			return in;
 		err = decode_compound_rule(str_buf, aff_data->flag_type,
 		                           aff_data->encoding, out);
+		aff_data->flag_ids.insert_compound_rule(out);
 		if (static_cast<int>(err) > 0) {
 			in.setstate(in.failbit);
 			if (in.exceptions() & in.failbit)
@@ -780,8 +863,235 @@ auto parse_affix(Aff_Line_Stream& in, string& command, vector<AffixT>& vec,
 	}
 }
 
+/**
+ * @brief Computes the Affix_Property bits of an affix entry.
+ *
+ * Prefixes need the compound permit flag at the end of a compound, suffixes
+ * at the beginning.
+ */
+template <class AffixT>
+auto affix_properties(const AffixT& e, const Aff_Data& aff) -> uint16_t
+{
+	constexpr auto permit_mode = is_same_v<AffixT, Prefix<wchar_t>>
+	                                 ? AT_COMPOUND_END
+	                                 : AT_COMPOUND_BEGIN;
+	auto& f = e.cont_flags;
+	auto ret = uint16_t(0);
+	if (f.contains(aff.compound_onlyin_flag))
+		ret |= NOT_VALID << FULL_WORD | IS_COMPOUND_ONLY;
+	if (f.contains(aff.compound_forbid_flag))
+		ret |= NOT_VALID << AT_COMPOUND_BEGIN |
+		       NOT_VALID << AT_COMPOUND_END |
+		       NOT_VALID << AT_COMPOUND_MIDDLE;
+	if (!f.contains(aff.compound_permit_flag))
+		ret |= NOT_VALID << permit_mode;
+	if (f.contains(aff.need_affix_flag))
+		ret |= NEEDS_AFFIX;
+	if (f.contains(aff.circumfix_flag))
+		ret |= IS_CIRCUMFIX;
+
+	auto compound = f.contains(aff.compound_flag);
+	ret |= VALID_INSIDE_COMPOUND << FULL_WORD;
+	if (compound || f.contains(aff.compound_begin_flag))
+		ret |= VALID_INSIDE_COMPOUND << AT_COMPOUND_BEGIN;
+	if (compound || f.contains(aff.compound_last_flag))
+		ret |= VALID_INSIDE_COMPOUND << AT_COMPOUND_END;
+	if (compound || f.contains(aff.compound_middle_flag))
+		ret |= VALID_INSIDE_COMPOUND << AT_COMPOUND_MIDDLE;
+	return ret;
+}
+
+template <class AffixT>
+auto erase_compound_only_affixes(vector<AffixT>& vec, const Aff_Data& aff)
+    -> void
+{
+	auto it = remove_if(begin(vec), end(vec), [&](const AffixT& e) {
+		return affix_properties(e, aff) & (NOT_VALID << FULL_WORD);
+	});
+	vec.erase(it, end(vec));
+}
 } // namespace
 
+/**
+ * @brief Computes the Affix_Property bits of all prefixes and suffixes.
+ *
+ * Must be called after the affix tables or the flags they depend on are
+ * changed. Dict_Base::specialize_spelling() calls it.
+ */
+auto Aff_Data::compute_affix_properties() -> void
+{
+	prefixes.set_properties(
+	    [&](const Prefix<wchar_t>& x) { return affix_properties(x, *this); });
+	suffixes.set_properties(
+	    [&](const Suffix<wchar_t>& x) { return affix_properties(x, *this); });
+}
+
+namespace {
+auto is_valid_unicode(std::wstring_view s) -> bool
+{
+	using namespace boost::locale::utf;
+	for (auto it = s.data(), last = it + s.size(); it != last;) {
+		auto cp = utf_traits<wchar_t>::decode(it, last);
+		if (cp == illegal || cp == incomplete)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Number of bytes of the UTF-8 encoding of @p s, counting each invalid
+ * code unit as a two byte sequence.
+ */
+auto utf8_length(std::wstring_view s) -> size_t
+{
+	auto n = size_t(0);
+	for (auto c : s) {
+		auto u = static_cast<make_unsigned_t<wchar_t>>(c);
+		if (u < 0x80)
+			n += 1;
+		else if (u < 0x800 || (u >= 0xD800 && u < 0xE000))
+			n += 2;
+		else if (u < 0x10000)
+			n += 3;
+		else
+			n += 4;
+	}
+	return n;
+}
+} // namespace
+
+auto Word_List::store(std::wstring_view word) -> Stored_Word
+{
+	if (utf8_storage) {
+		utf8_buffer.clear();
+		append_wide_to_utf8(word, utf8_buffer);
+		if (utf8_buffer.size() == word.size() || is_valid_unicode(word))
+			return {utf8_arena.store(utf8_buffer), word.size()};
+		has_wide_words = true;
+	}
+	return Stored_Word(arena.store(word));
+}
+
+auto Word_List::build_prefix_index() -> void
+{
+	sorted_words.clear();
+	sorted_utf8_words.clear();
+	if (utf8_storage) {
+		if (has_wide_words)
+			return;
+		sorted_utf8_words.reserve(size());
+		for (size_t i = 0; i != bucket_count(); ++i)
+			for (auto& x : bucket_data(i))
+				sorted_utf8_words.push_back(
+				    x.first.utf8_chars());
+		sort(begin(sorted_utf8_words), end(sorted_utf8_words));
+		return;
+	}
+	sorted_words.reserve(size());
+	for (size_t i = 0; i != bucket_count(); ++i)
+		for (auto& x : bucket_data(i))
+			sorted_words.push_back(x.first.wide_chars());
+	sort(begin(sorted_words), end(sorted_words));
+}
+
+/**
+ * @brief Walks the words that begin with the first characters of @p str.
+ *
+ * Requires build_prefix_index(). One walk from the start of @p str finds all
+ * of its prefixes that are words and the longest one that is a prefix of some
+ * word.
+ */
+auto Word_List::match_prefixes(std::wstring_view str) const -> Prefix_Match
+{
+	if (utf8_storage)
+		return match_utf8_prefixes(str);
+	auto ret = Prefix_Match();
+	auto first = begin(sorted_words);
+	auto last = end(sorted_words);
+	for (size_t d = 0; first != last; ++d) {
+		// here all words in [first, last) begin with str[0, d) and the
+		// ones equal to it sort first
+		if (first->size() == d) {
+			if (d < 64)
+				ret.word_ends |= uint64_t(1) << d;
+			first = partition_point(first, last, [&](auto& w) {
+				return w.size() == d;
+			});
+		}
+		if (d == str.size())
+			break;
+		auto c = str[d];
+		first = lower_bound(first, last, c, [&](auto& w, wchar_t c) {
+			return w[d] < c;
+		});
+		last = upper_bound(first, last, c, [&](wchar_t c, auto& w) {
+			return c < w[d];
+		});
+		if (first != last)
+			ret.depth = d + 1;
+	}
+	return ret;
+}
+
+/**
+ * @brief Same as match_prefixes() for words stored as UTF-8.
+ *
+ * The walk goes over the bytes of the UTF-8 encoding of @p str, which is
+ * encoded one code point at a time. Words end only between code points. A
+ * partly matched surrogate pair counts as matching its first code unit,
+ * which can only make the depth larger than for wide words.
+ */
+auto Word_List::match_utf8_prefixes(std::wstring_view str) const
+    -> Prefix_Match
+{
+	using namespace boost::locale::utf;
+	auto ret = Prefix_Match();
+	auto first = begin(sorted_utf8_words);
+	auto last = end(sorted_utf8_words);
+	auto it = str.data();
+	auto str_end = str.data() + str.size();
+	char bytes[4];
+	for (size_t b = 0; first != last;) {
+		// here all words in [first, last) begin with the b bytes of
+		// str[0, d) and the ones equal to it sort first
+		auto d = size_t(it - str.data());
+		if (first->size() == b) {
+			if (d < 64)
+				ret.word_ends |= uint64_t(1) << d;
+			first = partition_point(first, last, [&](auto& w) {
+				return w.size() == b;
+			});
+		}
+		if (it == str_end)
+			break;
+		auto cp = utf_traits<wchar_t>::decode(it, str_end);
+		if (cp == illegal || cp == incomplete)
+			break;
+		auto n = size_t(utf_traits<char>::encode(cp, bytes) - bytes);
+		auto k = size_t(0);
+		for (; k != n; ++k, ++b) {
+			auto c = static_cast<unsigned char>(bytes[k]);
+			first = lower_bound(
+			    first, last, c, [&](auto& w, unsigned char c) {
+				    return w.size() <= b ||
+				           static_cast<unsigned char>(w[b]) < c;
+			    });
+			last = upper_bound(
+			    first, last, c, [&](unsigned char c, auto& w) {
+				    return c < static_cast<unsigned char>(w[b]);
+			    });
+			if (first == last)
+				break;
+		}
+		auto units = size_t(it - str.data()) - d;
+		if (k == n)
+			ret.depth = d + units;
+		else if (k != 0 && units == 2)
+			ret.depth = d + 1;
+	}
+	return ret;
+}
+
 /**
  * Parses an input stream offering affix information.
  *
@@ -806,6 +1116,7 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	max_ngram_suggestions = 4;
 	max_diff_factor = 5;
 	flag_type = Flag_Type::SINGLE_CHAR;
+	flag_ids = {};
 
 	unordered_map<string, wstring*> command_wstrings = {
 	    {"IGNORE", &ignored_chars},
@@ -1016,6 +1327,13 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	for (auto& x : suffixes) {
 		erase_chars(x.appending, ignored_chars);
 	}
+	// Affixes valid only inside compounds are dead weight in the affix
+	// tables of dictionaries that do not compound.
+	if (!compound_flag && !compound_begin_flag && !compound_middle_flag &&
+	    !compound_last_flag && compound_rules.empty()) {
+		erase_compound_only_affixes(prefixes, *this);
+		erase_compound_only_affixes(suffixes, *this);
+	}
 	this->prefixes = std::move(prefixes);
 	this->suffixes = std::move(suffixes);
 
@@ -1051,40 +1369,71 @@ auto dic_find_end_of_word_heuristics(const string& line)
 	return line.npos;
 }
 
+namespace {
 /**
- * Parses an input stream offering dictionary information.
+ * @brief Words parsed from a part of the .dic file by one thread.
+ */
+struct Dic_Chunk {
+	std::wstring words; // all words concatenated
+	std::vector<size_t> word_ends;
+	std::vector<size_t> word_flags; // indexes into flag_sets
+	std::vector<Flag_Set> flag_sets;
+	std::unordered_map<std::u16string, size_t> flag_set_indexes;
+	std::vector<std::pair<Parsing_Error_Code, size_t>> errors;
+
+	auto add_flags(Flag_Set&& flags) -> size_t
+	{
+		auto it = flag_set_indexes.emplace(flags.data(),
+		                                   flag_sets.size());
+		if (it.second)
+			flag_sets.push_back(move(flags));
+		return it.first->second;
+	}
+	auto add_word(std::wstring_view word, size_t flags) -> void
+	{
+		words += word;
+		word_ends.push_back(words.size());
+		word_flags.push_back(flags);
+	}
+};
+
+/**
+ * @brief Parses the lines of a part of the .dic file.
  *
- * @param in input stream to read from.
- * @return true on success.
+ * Only reads @p aff, so many chunks can be parsed in parallel.
+ *
+ * @param aff parsed affix data.
+ * @param text whole lines of the .dic file.
+ * @param line_number the line number of the line before @p text.
+ * @param out the result.
  */
-auto Aff_Data::parse_dic(istream& in) -> bool
+auto parse_dic_chunk(const Aff_Data& aff, string_view text, size_t line_number,
+                     Dic_Chunk& out) -> void
 {
-	size_t line_number = 1;
-	size_t approximate_size;
 	string line;
 	string word;
 	string flags_str;
 	u16string flags;
 	wstring wide_word;
-	auto enc_conv = Encoding_Converter(encoding.value_or_default());
-
-	// locale must be without thousands separator.
+	auto enc_conv = Encoding_Converter(aff.encoding.value_or_default());
 	auto& ctype = use_facet<std::ctype<char>>(locale::classic());
-	in.imbue(locale::classic());
-	Setlocale_To_C_In_Scope setlocale_to_C;
-
-	strip_utf8_bom(in);
-	if (in >> approximate_size)
-		words.reserve(approximate_size);
-	else
-		return false;
-	getline(in, line);
-
-	while (getline(in, line)) {
+	// most words share few distinct strings of flags
+	auto decoded_flags =
+	    unordered_map<string, pair<size_t, Parsing_Error_Code>>();
+
+	// index 0 is no flags, aliases follow in order.
+	out.add_flags({});
+	out.flag_sets.insert(end(out.flag_sets), begin(aff.flag_aliases),
+	                     end(aff.flag_aliases));
+
+	while (!text.empty()) {
+		auto nl = text.find('\n');
+		line.assign(text.substr(0, nl));
+		text.remove_prefix(nl == text.npos ? text.size() : nl + 1);
 		line_number++;
 		word.clear();
 		flags_str.clear();
-		flags.clear();
+		size_t word_flags = 0;
 
 		size_t slash_pos = 0;
 		size_t tab_pos = 0;
@@ -1107,10 +1456,32 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			auto end_flags_pos = ptr - begin_ptr(line);
 			flags_str.assign(line, slash_pos + 1,
 			                 end_flags_pos - (slash_pos + 1));
-			auto err = decode_flags_possible_alias(
-			    flags_str, flag_type, encoding, flag_aliases,
-			    flags);
-			report_parsing_error(err, line_number);
+			auto err = Parsing_Error_Code();
+			if (aff.flag_aliases.empty()) {
+				auto it = decoded_flags.find(flags_str);
+				if (it == end(decoded_flags)) {
+					err = decode_flags(flags_str, aff.flag_type,
+					                   aff.encoding, flags);
+					aff.flag_ids.find(flags);
+					auto i = size_t(0);
+					if (static_cast<int>(err) <= 0)
+						i = out.add_flags(Flag_Set(flags));
+					it = decoded_flags
+					         .emplace(flags_str, pair(i, err))
+					         .first;
+				}
+				word_flags = it->second.first;
+				err = it->second.second;
+			}
+			else {
+				size_t i;
+				err = decode_alias_index(
+				    flags_str, aff.flag_aliases.size(), i);
+				if (static_cast<int>(err) <= 0)
+					word_flags = i + 1;
+			}
+			if (err != Parsing_Error_Code::NO_ERROR)
+				out.errors.emplace_back(err, line_number);
 			if (static_cast<int>(err) > 0)
 				continue;
 		}
@@ -1128,12 +1499,13 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 		auto ok = enc_conv.to_wide(word, wide_word);
 		if (!ok)
 			continue;
-		erase_chars(wide_word, ignored_chars);
+		erase_chars(wide_word, aff.ignored_chars);
 		auto casing = classify_casing(wide_word);
-		auto inserted = words.emplace(wide_word, flags);
+		out.add_word(wide_word, word_flags);
+		auto& word_flag_set = out.flag_sets[word_flags];
 		switch (casing) {
 		case Casing::ALL_CAPITAL:
-			if (flags.empty())
+			if (word_flag_set.empty())
 				break;
 			[[fallthrough]];
 		case Casing::PASCAL:
@@ -1143,17 +1515,594 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			// forbiddenword_flag, but by keeping the hidden
 			// homonym last in the multimap among the same-key
 			// entries.
-			if (inserted->second.contains(forbiddenword_flag))
+			if (word_flag_set.contains(aff.forbiddenword_flag))
 				break;
-			auto title_word = to_title(wide_word, icu_locale);
-			flags += HIDDEN_HOMONYM_FLAG;
-			words.emplace(title_word, flags);
+			auto title_word = to_title(wide_word, aff.icu_locale);
+			auto hidden_homonym_flags = word_flag_set;
+			hidden_homonym_flags.insert(Aff_Data::HIDDEN_HOMONYM_FLAG);
+			out.add_word(title_word,
+			             out.add_flags(move(hidden_homonym_flags)));
 			break;
 		}
 		default:
 			break;
 		}
 	}
-	return in.eof(); // success if we reached eof
+}
+} // namespace
+
+/**
+ * Parses an input stream offering dictionary information.
+ *
+ * The lines are split in chunks that are parsed on multiple threads, then
+ * the words are inserted in the original order.
+ *
+ * @param in input stream to read from.
+ * @param num_threads maximal number of threads, 0 for the number of hardware
+ * threads.
+ * @return true on success.
+ */
+auto Aff_Data::parse_dic(istream& in, size_t num_threads) -> bool
+{
+	size_t approximate_size;
+	string line;
+
+	// locale must be without thousands separator.
+	in.imbue(locale::classic());
+	Setlocale_To_C_In_Scope setlocale_to_C;
+
+	strip_utf8_bom(in);
+	if (in >> approximate_size)
+		words.reserve(approximate_size);
+	else
+		return false;
+	getline(in, line);
+	auto text = string();
+	for (size_t n = 0; in;) {
+		text.resize(n + 65536);
+		in.read(&text[n], 65536);
+		n += in.gcount();
+		text.resize(n);
+	}
+	if (in.bad())
+		return false;
+
+	// Split in line aligned chunks, but don't bother threads with less
+	// than 64 KiB each.
+	if (num_threads == 0)
+		num_threads = max(thread::hardware_concurrency(), 1u);
+	auto num_chunks = clamp(text.size() / 65536, size_t(1), num_threads);
+	auto chunk_bounds = vector<size_t>{0};
+	for (size_t i = 1; i != num_chunks; ++i) {
+		auto pos = max(text.size() * i / num_chunks, chunk_bounds.back());
+		pos = text.find('\n', pos);
+		if (pos == text.npos)
+			break;
+		chunk_bounds.push_back(pos + 1);
+	}
+	chunk_bounds.push_back(text.size());
+	num_chunks = chunk_bounds.size() - 1;
+
+	// Exceptions are moved out of the workers and rethrown after all of
+	// them are joined, as no thread may be left running or joinable.
+	auto chunks = vector<Dic_Chunk>(num_chunks);
+	auto exceptions = vector<exception_ptr>(num_chunks);
+	auto threads = vector<thread>();
+	threads.reserve(num_chunks - 1);
+	size_t line_number = 1;
+	for (size_t i = 0; i != num_chunks; ++i) {
+		auto chunk_text = string_view(text).substr(
+		    chunk_bounds[i], chunk_bounds[i + 1] - chunk_bounds[i]);
+		auto work = [this, chunk_text, line_number, &chunk = chunks[i],
+		             &e = exceptions[i]] {
+			try {
+				Setlocale_To_C_In_Scope setlocale_to_C;
+				parse_dic_chunk(*this, chunk_text, line_number,
+				                chunk);
+			}
+			catch (...) {
+				e = current_exception();
+			}
+		};
+		line_number += count(begin(chunk_text), end(chunk_text), '\n');
+		if (i + 1 == num_chunks) {
+			work();
+			continue;
+		}
+		try {
+			threads.emplace_back(work);
+		}
+		catch (...) {
+			exceptions[i] = current_exception();
+			break;
+		}
+	}
+	for (auto& t : threads)
+		t.join();
+	for (auto& e : exceptions)
+		if (e)
+			rethrow_exception(e);
+
+	// Store the words as UTF-8 when that takes less memory, which is the
+	// case for most languages. With UTF-16 wchar_t, it is not for scripts
+	// with three byte UTF-8 sequences, e.g. of the languages of India.
+	auto wide_length = size_t(0);
+	auto utf8_size = size_t(0);
+	for (auto& chunk : chunks) {
+		wide_length += chunk.words.size();
+		utf8_size += utf8_length(chunk.words);
+	}
+	words.set_utf8_storage(utf8_size < wide_length * sizeof(wchar_t));
+
+	auto flag_sets = vector<const Flag_Set*>();
+	for (auto& chunk : chunks) {
+		for (auto& e : chunk.errors)
+			report_parsing_error(e.first, e.second);
+		flag_sets.clear();
+		for (auto& f : chunk.flag_sets)
+			flag_sets.push_back(words.intern_flags(f));
+		auto word_begin = size_t(0);
+		auto chunk_words = wstring_view(chunk.words);
+		for (size_t i = 0; i != chunk.word_ends.size(); ++i) {
+			auto word_end = chunk.word_ends[i];
+			auto word = chunk_words.substr(word_begin,
+			                               word_end - word_begin);
+			words.emplace(word, flag_sets[chunk.word_flags[i]]);
+			word_begin = word_end;
+		}
+		chunk = Dic_Chunk();
+	}
+	build_case_table();
+	return true;
+}
+
+/**
+ * @brief Builds the case table for the characters of the words, the affixes
+ * and the suggestion options.
+ */
+auto Aff_Data::build_case_table() -> void
+{
+	auto seen = vector<bool>(0x110000);
+	auto alphabet = wstring();
+	auto add = [&](wstring_view s) {
+		for (auto c : s) {
+			auto u = static_cast<make_unsigned_t<wchar_t>>(c);
+			if (u < seen.size() && !seen[u]) {
+				seen[u] = true;
+				alphabet += c;
+			}
+		}
+	};
+	auto buffer = wstring();
+	for (size_t i = 0; i != words.bucket_count(); ++i)
+		for (auto& w : words.bucket_data(i))
+			add(w.first.to_wide(buffer));
+	for (auto& p : prefixes) {
+		add(p.appending);
+		add(p.stripping);
+	}
+	for (auto& x : suffixes) {
+		add(x.appending);
+		add(x.stripping);
+	}
+	add(try_chars);
+	add(keyboard_closeness);
+	case_table.build(alphabet, icu_locale);
+}
+
+namespace {
+/**
+ * @brief Header of a compiled dictionary.
+ *
+ * It is followed by the payload, the sections of which are aligned to 8 bytes:
+ * the path of the source dictionary, the text of the .aff file, offsets and
+ * characters of the distinct flag sets, offsets, flag set indexes, lengths
+ * and characters of the words in the order of their slots in the hash table,
+ * the control bytes of the hash table and the bits of the Bloom filter.
+ *
+ * The characters of a word are either UTF-8 or wchar_t, aligned for it. Its
+ * length is given twice, in code units of its encoding and as the length of
+ * the wide string with WORD_UTF8_BIT set if it is UTF-8.
+ */
+struct Compiled_Header {
+	char magic[8];
+	uint32_t version;
+	uint16_t char_size;
+	uint16_t byte_order;
+	uint32_t size_t_size;
+	uint32_t source_path_size;
+	uint64_t source_aff_size;
+	uint64_t source_dic_size;
+	int64_t source_aff_mtime;
+	int64_t source_dic_mtime;
+	uint64_t source_hash;
+	uint64_t aff_size;
+	uint64_t num_flag_sets;
+	uint64_t num_flag_chars;
+	uint64_t num_words;
+	uint64_t num_word_bytes;
+	uint64_t utf8_words;
+	uint64_t table_capacity;
+	uint64_t num_slots;
+	uint64_t filter_capacity;
+	uint64_t num_filter_blocks;
+	uint64_t checksum;
+};
+const char COMPILED_MAGIC[8] = {'N', 'U', 'S', 'P', 'E', 'L', 'L', 'C'};
+// Bump when the format or the way .aff and .dic are parsed changes.
+const uint32_t COMPILED_VERSION = 4;
+const uint32_t WORD_UTF8_BIT = uint32_t(1) << 31;
+const uint16_t COMPILED_BYTE_ORDER = 0x0102;
+const uint64_t HASH_SEED = 0xcbf29ce484222325;
+
+/**
+ * @brief Hashes bytes eight at a time, used to detect changed or corrupted
+ * files, not for hash tables.
+ */
+auto hash_bytes(const char* data, size_t size, uint64_t h = HASH_SEED)
+    -> uint64_t
+{
+	const uint64_t k = 0x9e3779b97f4a7c15;
+	auto i = size_t(0);
+	for (; size - i >= 8; i += 8) {
+		uint64_t w;
+		std::memcpy(&w, data + i, 8);
+		h = (h ^ w) * k;
+		h ^= h >> 29;
+	}
+	auto w = uint64_t(0);
+	if (i != size)
+		std::memcpy(&w, data + i, size - i);
+	h = (h ^ w ^ (uint64_t(size) << 56)) * k;
+	return h ^ h >> 32;
+}
+
+auto append_section(string& out, const void* data, size_t size) -> void
+{
+	out.append(static_cast<const char*>(data), size);
+	out.resize((out.size() + 7) / 8 * 8);
+}
+
+class Compiled_Reader {
+	const char* ptr;
+	const char* end;
+
+      public:
+	Compiled_Reader(const char* data, size_t size)
+	    : ptr(data), end(data + size)
+	{
+	}
+	template <class T>
+	auto take(uint64_t count) -> const T*
+	{
+		if (count > size_t(end - ptr) / sizeof(T))
+			return nullptr;
+		auto ret = reinterpret_cast<const T*>(ptr);
+		auto size = (count * sizeof(T) + 7) / 8 * 8;
+		ptr += std::min(size, size_t(end - ptr));
+		return ret;
+	}
+};
+
+auto read_compiled_header(const char* data, size_t size, Compiled_Header& h)
+    -> bool
+{
+	if (size < sizeof(h))
+		return false;
+	std::memcpy(&h, data, sizeof(h));
+	return equal(begin(COMPILED_MAGIC), end(COMPILED_MAGIC), h.magic) &&
+	       h.version == COMPILED_VERSION &&
+	       h.char_size == sizeof(wchar_t) &&
+	       h.byte_order == COMPILED_BYTE_ORDER &&
+	       h.size_t_size == sizeof(size_t) &&
+	       h.source_path_size <= size - sizeof(h);
+}
+} // namespace
+
+/**
+ * @brief Fills this object from the .aff and .dic files at a path.
+ *
+ * @param path_without_extension path without .aff and .dic.
+ * @return false if one of the files can not be read.
+ */
+auto Dictionary_Source::read_files(const std::string& path_without_extension)
+    -> bool
+{
+	auto aff = Mapped_File(path_without_extension + ".aff");
+	auto dic = Mapped_File(path_without_extension + ".dic");
+	if (!aff.is_open() || !dic.is_open())
+		return false;
+	read_contents({aff.data(), aff.size()}, {dic.data(), dic.size()});
+	path = path_without_extension;
+	aff_mtime = aff.modification_time();
+	dic_mtime = dic.modification_time();
+	return true;
+}
+
+/**
+ * @brief Fills the sizes and the hash from the contents of .aff and .dic.
+ *
+ * The path and the modification times are cleared.
+ */
+auto Dictionary_Source::read_contents(std::string_view aff,
+                                      std::string_view dic) -> void
+{
+	path.clear();
+	aff_size = aff.size();
+	dic_size = dic.size();
+	aff_mtime = 0;
+	dic_mtime = 0;
+	hash = hash_bytes(dic.data(), dic.size(),
+	                  hash_bytes(aff.data(), aff.size()));
+}
+
+/**
+ * @brief Checks that the files at path were not changed.
+ *
+ * Files with the recorded sizes and modification times are not read. When
+ * only the times differ, the contents are hashed and compared. If the path is
+ * unknown or the files do not exist any more, there is nothing to compare
+ * with and true is returned.
+ */
+auto Dictionary_Source::is_up_to_date() const -> bool
+{
+	if (path.empty())
+		return true;
+	auto aff = Mapped_File(path + ".aff");
+	auto dic = Mapped_File(path + ".dic");
+	if (!aff.is_open() || !dic.is_open())
+		return true;
+	if (aff.size() != aff_size || dic.size() != dic_size)
+		return false;
+	if (aff.modification_time() == aff_mtime &&
+	    dic.modification_time() == dic_mtime)
+		return true;
+	auto h = hash_bytes(aff.data(), aff.size());
+	return hash_bytes(dic.data(), dic.size(), h) == hash;
+}
+
+/**
+ * @brief Writes the parsed dictionary in the compiled binary format.
+ *
+ * @param aff_text the contents of the .aff file this object was parsed from.
+ * @param source the files this object was parsed from.
+ * @param out binary stream to write to.
+ * @return true on success.
+ */
+auto Aff_Data::write_compiled(std::string_view aff_text,
+                              const Dictionary_Source& source,
+                              ostream& out) const -> bool
+{
+	auto set_indexes = unordered_map<const Flag_Set*, uint32_t>();
+	auto set_offsets = vector<uint64_t>{0};
+	auto set_chars = u16string();
+	auto word_offsets = vector<uint64_t>();
+	auto word_sets = vector<uint32_t>();
+	auto word_units = vector<uint32_t>();
+	auto word_sizes = vector<uint32_t>();
+	auto word_bytes = string();
+	word_offsets.reserve(words.size());
+	word_sets.reserve(words.size());
+	word_units.reserve(words.size());
+	word_sizes.reserve(words.size());
+	for (size_t i = 0; i != words.bucket_count(); ++i) {
+		for (auto& w : words.bucket_data(i)) {
+			auto it = set_indexes.emplace(w.second, set_indexes.size());
+			if (it.second) {
+				set_chars += w.second->data();
+				set_offsets.push_back(set_chars.size());
+			}
+			auto& word = w.first;
+			auto size = uint32_t(word.size());
+			if (word.is_utf8()) {
+				auto chars = word.utf8_chars();
+				word_offsets.push_back(word_bytes.size());
+				word_bytes += chars;
+				word_units.push_back(chars.size());
+				size |= WORD_UTF8_BIT;
+			}
+			else {
+				auto chars = word.wide_chars();
+				auto align = alignof(wchar_t);
+				auto a = word_bytes.size();
+				a = (a + align - 1) / align * align;
+				word_bytes.resize(a);
+				word_offsets.push_back(a);
+				word_bytes.append(
+				    reinterpret_cast<const char*>(chars.data()),
+				    chars.size() * sizeof(wchar_t));
+				word_units.push_back(chars.size());
+			}
+			word_sizes.push_back(size);
+			word_sets.push_back(it.first->second);
+		}
+	}
+	auto& filter = words.get_filter();
+
+	auto payload = string();
+	append_section(payload, source.path.data(), source.path.size());
+	append_section(payload, aff_text.data(), aff_text.size());
+	append_section(payload, set_offsets.data(),
+	               set_offsets.size() * sizeof(uint64_t));
+	append_section(payload, set_chars.data(),
+	               set_chars.size() * sizeof(char16_t));
+	append_section(payload, word_offsets.data(),
+	               word_offsets.size() * sizeof(uint64_t));
+	append_section(payload, word_sets.data(),
+	               word_sets.size() * sizeof(uint32_t));
+	append_section(payload, word_units.data(),
+	               word_units.size() * sizeof(uint32_t));
+	append_section(payload, word_sizes.data(),
+	               word_sizes.size() * sizeof(uint32_t));
+	append_section(payload, word_bytes.data(), word_bytes.size());
+	append_section(payload, words.table_controls(),
+	               words.bucket_count() + 16);
+	append_section(payload, filter.words(),
+	               filter.block_count() * 8 * sizeof(uint32_t));
+
+	auto h = Compiled_Header();
+	copy(begin(COMPILED_MAGIC), end(COMPILED_MAGIC), h.magic);
+	h.version = COMPILED_VERSION;
+	h.char_size = sizeof(wchar_t);
+	h.byte_order = COMPILED_BYTE_ORDER;
+	h.size_t_size = sizeof(size_t);
+	h.source_path_size = source.path.size();
+	h.source_aff_size = source.aff_size;
+	h.source_dic_size = source.dic_size;
+	h.source_aff_mtime = source.aff_mtime;
+	h.source_dic_mtime = source.dic_mtime;
+	h.source_hash = source.hash;
+	h.aff_size = aff_text.size();
+	h.num_flag_sets = set_offsets.size() - 1;
+	h.num_flag_chars = set_chars.size();
+	h.num_words = word_sets.size();
+	h.num_word_bytes = word_bytes.size();
+	h.utf8_words = words.uses_utf8_storage();
+	h.table_capacity = words.table_capacity();
+	h.num_slots = words.bucket_count();
+	h.filter_capacity = filter.capacity();
+	h.num_filter_blocks = filter.block_count();
+	h.checksum = hash_bytes(payload.data(), payload.size());
+	out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	out.write(payload.data(), payload.size());
+	return bool(out);
+}
+
+/**
+ * @brief Reads which files a compiled dictionary was built from.
+ *
+ * Only the header is read, so this is cheap to call before deciding whether
+ * to load the compiled dictionary or to rebuild it.
+ *
+ * @return false if the data is not a compiled dictionary of this version.
+ */
+auto Aff_Data::read_compiled_source(const char* data, size_t size,
+                                    Dictionary_Source& source) -> bool
+{
+	auto h = Compiled_Header();
+	if (!read_compiled_header(data, size, h))
+		return false;
+	source.path.assign(data + sizeof(h), h.source_path_size);
+	source.aff_size = h.source_aff_size;
+	source.dic_size = h.source_dic_size;
+	source.aff_mtime = h.source_aff_mtime;
+	source.dic_mtime = h.source_dic_mtime;
+	source.hash = h.source_hash;
+	return true;
+}
+
+/**
+ * @brief Checks the checksum of a compiled dictionary.
+ *
+ * This reads the whole file, so it is done after writing it and not by
+ * parse_compiled(), which touches only the pages it needs.
+ *
+ * @return false if the data is not a compiled dictionary of this version or
+ * it is corrupted.
+ */
+auto Aff_Data::verify_compiled(const char* data, size_t size) -> bool
+{
+	auto h = Compiled_Header();
+	if (!read_compiled_header(data, size, h))
+		return false;
+	return hash_bytes(data + sizeof(h), size - sizeof(h)) == h.checksum;
+}
+
+/**
+ * @brief Loads a dictionary written by write_compiled().
+ *
+ * The words are not copied, they are used directly from @p data, and the
+ * hash table and its filter are restored without hashing the words again,
+ * which is possible because Polynomial_Hash gives the same values on every
+ * platform with the same sizes of wchar_t and size_t. The affix tables are
+ * small and are rebuilt by parsing the embedded .aff text.
+ *
+ * The checksum is not verified here, see verify_compiled(). The offsets and
+ * sizes are still checked against @p size.
+ *
+ * @param data start of the compiled dictionary, aligned to 8 bytes.
+ * @param size size of the compiled dictionary in bytes.
+ * @param owner keeps @p data alive for as long as this object is alive.
+ * @return false if the data is malformed or was written by a different
+ * version.
+ */
+auto Aff_Data::parse_compiled(const char* data, size_t size,
+                              std::shared_ptr<const void> owner) -> bool
+{
+	auto h = Compiled_Header();
+	if (!read_compiled_header(data, size, h))
+		return false;
+	data += sizeof(h);
+	size -= sizeof(h);
+
+	auto r = Compiled_Reader(data, size);
+	r.take<char>(h.source_path_size);
+	auto aff_text = r.take<char>(h.aff_size);
+	auto set_offsets = r.take<uint64_t>(h.num_flag_sets + 1);
+	auto set_chars = r.take<char16_t>(h.num_flag_chars);
+	auto word_offsets = r.take<uint64_t>(h.num_words);
+	auto word_sets = r.take<uint32_t>(h.num_words);
+	auto word_units = r.take<uint32_t>(h.num_words);
+	auto word_sizes = r.take<uint32_t>(h.num_words);
+	auto word_bytes = r.take<char>(h.num_word_bytes);
+	auto controls = r.take<unsigned char>(h.num_slots + 16);
+	auto filter_words = r.take<uint32_t>(h.num_filter_blocks * 8);
+	if (!aff_text || !set_offsets || !set_chars || !word_offsets ||
+	    !word_sets || !word_units || !word_sizes || !word_bytes ||
+	    !controls || !filter_words ||
+	    (h.num_filter_blocks == 0 && h.filter_capacity != 0))
+		return false;
+
+	auto aff = istringstream(string(aff_text, h.aff_size));
+	if (!parse_aff(aff))
+		return false;
+
+	auto flag_sets = vector<const Flag_Set*>();
+	flag_sets.reserve(h.num_flag_sets);
+	for (size_t i = 0; i != h.num_flag_sets; ++i) {
+		auto a = set_offsets[i];
+		auto b = set_offsets[i + 1];
+		if (a > b || b > h.num_flag_chars)
+			return false;
+		auto flags = Flag_Set(u16string(set_chars + a, set_chars + b));
+		flag_sets.push_back(words.intern_flags(flags));
+	}
+	auto entries = vector<Word_List::value_type>();
+	entries.reserve(h.num_words);
+	for (size_t i = 0; i != h.num_words; ++i) {
+		auto a = word_offsets[i];
+		auto units = uint64_t(word_units[i]);
+		auto size = word_sizes[i] & ~WORD_UTF8_BIT;
+		auto is_utf8 = (word_sizes[i] & WORD_UTF8_BIT) != 0;
+		auto unit_size = is_utf8 ? sizeof(char) : sizeof(wchar_t);
+		if (a > h.num_word_bytes ||
+		    units > (h.num_word_bytes - a) / unit_size ||
+		    word_sets[i] >= flag_sets.size())
+			return false;
+		auto word = Stored_Word();
+		if (is_utf8) {
+			if (!h.utf8_words || size > units)
+				return false;
+			word = Stored_Word(string_view(word_bytes + a, units),
+			                   size);
+		}
+		else {
+			if (a % alignof(wchar_t) != 0 || size != units)
+				return false;
+			auto chars =
+			    reinterpret_cast<const wchar_t*>(word_bytes + a);
+			word = Stored_Word(wstring_view(chars, units));
+		}
+		entries.emplace_back(word, flag_sets[word_sets[i]]);
+	}
+	auto filter = Bloom_Filter();
+	filter.restore(h.filter_capacity, filter_words, h.num_filter_blocks);
+	if (!words.restore(h.table_capacity, controls, h.num_slots,
+	                   begin(entries), entries.size(), move(filter),
+	                   h.utf8_words))
+		return false;
+	words.hold(move(owner));
+	build_case_table();
+	return true;
 }
 } // namespace nuspell
@@ -25,10 +25,18 @@
 #define NUSPELL_AFF_DATA_HXX
 
 #include "structures.hxx"
+#include "utils.hxx"
 
 #include <iosfwd>
+#include <unordered_map>
 #include <unicode/locid.h>
 
+// Set by the CMake option of the same name. Changes the inline functions of
+// Word_List, so it must be the same for the library and its users.
+#ifndef NUSPELL_FILTER_STATS
+#define NUSPELL_FILTER_STATS 0
+#endif
+
 namespace nuspell {
 inline namespace v3 {
 
@@ -83,8 +91,174 @@ enum class Flag_Type {
 	UTF8 /**< UTF-8 flag, e.g. for "á" */
 };
 
+/**
+ * @brief Maps flags to small dense ids.
+ *
+ * Flag_Set tests flags below 256 with a bitset. Flags of the types LONG, NUM
+ * and UTF-8 are usually above that, so for them the parser renumbers every
+ * flag found in the .aff file to a dense id. Flags found only in the .dic
+ * file are never tested individually and all get the same id.
+ *
+ * While disabled, flags are mapped to themselves.
+ */
+class Flag_Id_Map {
+	std::unordered_map<char16_t, char16_t> ids;
+	char16_t next_id = 1;
+	char16_t unknown_id = 0;
+
+      public:
+	auto enabled() const { return unknown_id != 0; }
+	auto enable() -> void;
+	auto insert(char16_t flag) -> char16_t;
+	auto insert(std::u16string& flags) -> void;
+	auto insert_compound_rule(std::u16string& rule) -> void;
+	auto find(char16_t flag) const -> char16_t;
+	auto find(std::u16string& flags) const -> void;
+};
+
+/**
+ * @brief Characters of a word of a Word_List, either as wchar_t or as UTF-8.
+ *
+ * A word stored as UTF-8 is compared with and hashed as the wide string it
+ * encodes. Its code points are decoded on the fly, so lookups with wide
+ * strings do not convert the looked up string. size() is always the length of
+ * the wide string.
+ */
+class Stored_Word {
+	static constexpr uint32_t utf8_bit = uint32_t(1) << 31;
+	const void* chars = nullptr;
+	uint32_t num_units = 0;     // of chars, char or wchar_t
+	uint32_t size_and_utf8 = 0; // wide size, utf8_bit if UTF-8
+
+      public:
+	Stored_Word() = default;
+	explicit Stored_Word(std::wstring_view word)
+	    : chars(word.data()), num_units(word.size()),
+	      size_and_utf8(word.size())
+	{
+	}
+	Stored_Word(std::string_view utf8, size_t wide_size)
+	    : chars(utf8.data()), num_units(utf8.size()),
+	      size_and_utf8(wide_size | utf8_bit)
+	{
+	}
+
+	auto is_utf8() const -> bool { return size_and_utf8 & utf8_bit; }
+	auto size() const -> size_t { return size_and_utf8 & ~utf8_bit; }
+	/**
+	 * @brief The characters of a word that is not stored as UTF-8.
+	 */
+	auto wide_chars() const -> std::wstring_view
+	{
+		return {static_cast<const wchar_t*>(chars), num_units};
+	}
+	/**
+	 * @brief The characters of a word that is stored as UTF-8.
+	 */
+	auto utf8_chars() const -> std::string_view
+	{
+		return {static_cast<const char*>(chars), num_units};
+	}
+	/**
+	 * @brief Returns the word as a wide string, decoded into @p buffer if
+	 * the word is stored as UTF-8.
+	 */
+	auto to_wide(std::wstring& buffer) const -> std::wstring_view
+	{
+		if (!is_utf8())
+			return wide_chars();
+		buffer.clear();
+		for_each_unit([&](wchar_t c) {
+			buffer += c;
+			return true;
+		});
+		return buffer;
+	}
+	/**
+	 * @brief Calls @p f with each wchar_t of the word until it returns
+	 * false.
+	 * @return false if @p f returned false.
+	 */
+	template <class Func>
+	auto for_each_unit(Func f) const -> bool
+	{
+		if (!is_utf8()) {
+			for (auto c : wide_chars())
+				if (!f(c))
+					return false;
+			return true;
+		}
+		auto s = utf8_chars();
+		auto byte = [&](size_t i) {
+			return char32_t(static_cast<unsigned char>(s[i]));
+		};
+		for (size_t i = 0; i != s.size();) {
+			auto cp = byte(i++);
+			if (cp >= 0x80) {
+				auto n = cp >= 0xF0 ? 3 : cp >= 0xE0 ? 2 : 1;
+				cp &= 0x3F >> n;
+				for (; n != 0 && i != s.size(); --n)
+					cp = cp << 6 | (byte(i++) & 0x3F);
+			}
+			if constexpr (sizeof(wchar_t) == 2) {
+				if (cp >= 0x10000) {
+					cp -= 0x10000;
+					if (!f(wchar_t(0xD800 | cp >> 10)))
+						return false;
+					cp = 0xDC00 | (cp & 0x3FF);
+				}
+			}
+			if (!f(wchar_t(cp)))
+				return false;
+		}
+		return true;
+	}
+};
+inline auto operator==(const Stored_Word& a, std::wstring_view b) -> bool
+{
+	if (a.size() != b.size())
+		return false;
+	if (!a.is_utf8())
+		return a.wide_chars() == b;
+	auto i = size_t(0);
+	return a.for_each_unit([&](wchar_t c) {
+		return i != b.size() && b[i++] == c;
+	}) && i == b.size();
+}
+inline auto operator==(std::wstring_view a, const Stored_Word& b) -> bool
+{
+	return b == a;
+}
+inline auto operator==(const Stored_Word& a, const Stored_Word& b) -> bool
+{
+	if (a.is_utf8() && b.is_utf8())
+		return a.utf8_chars() == b.utf8_chars();
+	if (!a.is_utf8())
+		return b == a.wide_chars();
+	return a == b.wide_chars();
+}
+
+/**
+ * @brief Polynomial_Hash<wchar_t> that also hashes a Stored_Word as the wide
+ * string it holds.
+ */
+struct Word_Hash : Polynomial_Hash<wchar_t> {
+	using Polynomial_Hash<wchar_t>::operator();
+	auto operator()(const Stored_Word& w) const -> size_t
+	{
+		if (!w.is_utf8())
+			return hash(w.wide_chars());
+		auto h = uint64_t(0);
+		w.for_each_unit([&](wchar_t c) {
+			h = h * base + std::make_unsigned_t<wchar_t>(c);
+			return true;
+		});
+		return h;
+	}
+};
+
 struct Extractor_First_of_Word_Pair {
-	auto& operator()(const std::pair<std::wstring, Flag_Set>& p) const
+	auto& operator()(const std::pair<Stored_Word, const Flag_Set*>& p) const
 	{
 		return p.first;
 	}
@@ -93,14 +267,282 @@ struct Extractor_First_of_Word_Pair {
 /**
  * @brief Map between words and word_flags.
  *
- * Flags are stored as part of the container. Maybe for the future flags should
- * be stored elsewhere (flag aliases) and this should store pointers.
+ * The characters of all words are kept in a few large buffers owned by the
+ * list, the elements only hold views into them. This avoids one heap
+ * allocation per word. Likewise, each distinct set of flags is stored only
+ * once in a Flag_Set_Pool and the elements point to it.
+ *
+ * With set_utf8_storage(), the words are stored as UTF-8, which takes a
+ * quarter of the memory of wchar_t on platforms where it is 32 bits wide for
+ * the words of alphabetic scripts. Lookups still take wide strings, see
+ * Stored_Word. Words that are not valid UTF-16 or UTF-32 are kept as wchar_t.
+ *
+ * Most lookups made while stripping affixes are for strings that are not
+ * words. A Bloom_Filter over all keys answers most of them without touching
+ * the hash table. When built with NUSPELL_FILTER_STATS, the outcome of the
+ * lookups is counted per thread, see filter_stats().
  *
  * Does not store morphological data as is low priority feature and is out of
  * scope.
  */
-using Word_List = Hash_Multiset<std::pair<std::wstring, Flag_Set>, std::wstring,
-                                Extractor_First_of_Word_Pair>;
+class Word_List {
+	using Table = Hash_Multiset<std::pair<Stored_Word, const Flag_Set*>,
+	                            Stored_Word, Extractor_First_of_Word_Pair,
+	                            Word_Hash>;
+	Table table;
+	Bloom_Filter filter;
+	String_Arena<wchar_t> arena;
+	String_Arena<char> utf8_arena;
+	Flag_Set_Pool flag_sets;
+	std::vector<std::shared_ptr<const void>> holders;
+	std::vector<std::wstring_view> sorted_words;
+	std::vector<std::string_view> sorted_utf8_words;
+	bool utf8_storage = false;
+	bool has_wide_words = false; // in UTF-8 storage
+	std::string utf8_buffer;
+
+	template <class Word>
+	static auto hash(const Word& word)
+	{
+		return Table::hasher()(word);
+	}
+	auto rebuild_filter(size_t capacity) -> void
+	{
+		filter.reset(capacity);
+		for (size_t i = 0; i != table.bucket_count(); ++i)
+			for (auto& x : table.bucket_data(i))
+				filter.insert(hash(x.first));
+	}
+	auto store(std::wstring_view word) -> Stored_Word;
+	auto insert_into_table(std::wstring_view word, const Flag_Set* flags)
+	    -> Table::local_iterator
+	{
+		if (table.size() >= filter.capacity())
+			rebuild_filter(std::max(table.size() * 2, size_t(64)));
+		filter.insert(hash(word));
+		sorted_words.clear();
+		sorted_utf8_words.clear();
+		return table.insert({store(word), flags});
+	}
+
+      public:
+	using key_type = Table::key_type;
+	using value_type = Table::value_type;
+	using hasher = Table::hasher;
+	using size_type = Table::size_type;
+	using reference = Table::reference;
+	using const_reference = Table::const_reference;
+	using pointer = Table::pointer;
+	using const_pointer = Table::const_pointer;
+	using local_iterator = Table::local_iterator;
+	using local_const_iterator = Table::local_const_iterator;
+
+	/**
+	 * @brief Outcomes of equal_range() calls.
+	 */
+	struct Filter_Stats {
+		size_t rejected = 0; /**< filtered out, table not accessed */
+		size_t found = 0;    /**< passed the filter and found */
+		size_t false_positives = 0; /**< passed the filter, not found */
+	};
+
+	/**
+	 * @brief Result of match_prefixes().
+	 */
+	struct Prefix_Match {
+		size_t depth = 0; /**< length of the longest prefix of a word */
+		uint64_t word_ends = 0; /**< bit n is set if n chars are a word */
+	};
+
+	Word_List() = default;
+	Word_List(const Word_List& other) { *this = other; }
+	Word_List(Word_List&& other) = default;
+	auto operator=(const Word_List& other) -> Word_List&
+	{
+		if (this == &other)
+			return *this;
+		table = Table();
+		filter = Bloom_Filter();
+		arena.clear();
+		utf8_arena.clear();
+		flag_sets.clear();
+		holders.clear();
+		utf8_storage = other.utf8_storage;
+		has_wide_words = false;
+		table.reserve(other.table.size());
+		auto buffer = std::wstring();
+		for (size_t i = 0; i != other.table.bucket_count(); ++i)
+			for (auto& x : other.table.bucket_data(i))
+				emplace(x.first.to_wide(buffer), *x.second);
+		if (other.has_prefix_index())
+			build_prefix_index();
+		return *this;
+	}
+	auto operator=(Word_List&& other) -> Word_List& = default;
+
+	auto size() const { return table.size(); }
+	auto empty() const { return table.empty(); }
+	/**
+	 * @brief Chooses whether the words inserted afterwards are stored as
+	 * UTF-8. Can be changed only while the list is empty.
+	 */
+	auto set_utf8_storage(bool enable) -> void
+	{
+		if (empty())
+			utf8_storage = enable;
+	}
+	auto uses_utf8_storage() const -> bool { return utf8_storage; }
+	auto reserve(size_t count) -> void
+	{
+		table.reserve(count);
+		if (count > filter.capacity())
+			rebuild_filter(count);
+	}
+
+	/**
+	 * @brief Returns the shared copy of @p flags owned by this list.
+	 */
+	auto intern_flags(const Flag_Set& flags) -> const Flag_Set*
+	{
+		return flag_sets.intern(flags);
+	}
+	/**
+	 * @brief Inserts a word with flags previously returned by
+	 * intern_flags() of this list.
+	 */
+	auto emplace(std::wstring_view word, const Flag_Set* flags)
+	    -> local_iterator
+	{
+		return insert_into_table(word, flags);
+	}
+	auto emplace(std::wstring_view word, const Flag_Set& flags)
+	    -> local_iterator
+	{
+		return emplace(word, intern_flags(flags));
+	}
+	auto insert(const std::pair<std::wstring_view, Flag_Set>& value)
+	    -> local_iterator
+	{
+		return emplace(value.first, value.second);
+	}
+	/**
+	 * @brief Keeps @p owner alive for as long as this list is alive.
+	 */
+	auto hold(std::shared_ptr<const void> owner) -> void
+	{
+		holders.push_back(move(owner));
+	}
+
+	auto equal_range(std::wstring_view key) const
+	    -> std::pair<local_const_iterator, local_const_iterator>
+	{
+		return equal_range(key, hash(key));
+	}
+	/**
+	 * @brief Same as equal_range(key), with @p h equal to hasher()(key)
+	 * already computed by the caller, e.g. derived with
+	 * hasher::replace_suffix() from the hash of a longer word.
+	 */
+	auto equal_range(std::wstring_view key, size_t h) const
+	    -> std::pair<local_const_iterator, local_const_iterator>
+	{
+		if (!filter.may_contain(h)) {
+			if constexpr (NUSPELL_FILTER_STATS)
+				++filter_stats().rejected;
+			return {};
+		}
+		auto r = table.equal_range(key, h);
+		if constexpr (NUSPELL_FILTER_STATS) {
+			auto& stats = filter_stats();
+			if (r.first != r.second)
+				++stats.found;
+			else
+				++stats.false_positives;
+		}
+		return r;
+	}
+	/**
+	 * @brief Checks the filter only. False means that there is no word
+	 * with hash @p h, true that there may be one.
+	 */
+	auto may_contain(size_t h) const { return filter.may_contain(h); }
+	/**
+	 * @brief Statistics of the lookups done by the calling thread in all
+	 * lists. Can be reset by assigning {} to it. Stays zero unless built
+	 * with NUSPELL_FILTER_STATS.
+	 */
+	static auto filter_stats() -> Filter_Stats&
+	{
+		static thread_local auto stats = Filter_Stats();
+		return stats;
+	}
+	auto bucket_count() const { return table.bucket_count(); }
+	auto bucket_data(size_type i) const { return table.bucket_data(i); }
+	auto table_capacity() const { return table.home_capacity(); }
+	auto table_controls() const { return table.controls(); }
+	auto get_filter() const -> const Bloom_Filter& { return filter; }
+
+	/**
+	 * @brief Restores the hash table and the filter of another list
+	 * without hashing the words, see Hash_Multiset::restore().
+	 *
+	 * The words are not copied, their characters must outlive this
+	 * list, see hold().
+	 *
+	 * @param utf8 uses_utf8_storage() of the other list.
+	 */
+	template <class InputIt>
+	auto restore(size_t capacity, const unsigned char* controls,
+	             size_t slots, InputIt first, size_t count,
+	             Bloom_Filter filter_of_other, bool utf8) -> bool
+	{
+		sorted_words.clear();
+		sorted_utf8_words.clear();
+		filter = std::move(filter_of_other);
+		utf8_storage = utf8;
+		has_wide_words = false;
+		if (!table.restore(capacity, controls, slots, first, count))
+			return false;
+		if (utf8)
+			for (size_t i = 0; i != bucket_count(); ++i)
+				for (auto& x : bucket_data(i))
+					has_wide_words |= !x.first.is_utf8();
+		return true;
+	}
+
+	/**
+	 * @brief Builds the sorted index used by match_prefixes(). Inserting a
+	 * word afterwards drops it.
+	 *
+	 * Not built for lists in UTF-8 storage that have words kept as
+	 * wchar_t.
+	 */
+	auto build_prefix_index() -> void;
+	auto has_prefix_index() const -> bool
+	{
+		return !sorted_words.empty() || !sorted_utf8_words.empty();
+	}
+	auto match_prefixes(std::wstring_view str) const -> Prefix_Match;
+
+      private:
+	auto match_utf8_prefixes(std::wstring_view str) const -> Prefix_Match;
+};
+
+/**
+ * @brief Identifies the .aff and .dic files of a compiled dictionary.
+ */
+struct Dictionary_Source {
+	std::string path; /**< path without extension, empty if unknown */
+	uint64_t aff_size = 0;
+	uint64_t dic_size = 0;
+	int64_t aff_mtime = 0;
+	int64_t dic_mtime = 0;
+	uint64_t hash = 0; /**< of the .aff contents followed by the .dic */
+
+	auto read_files(const std::string& path_without_extension) -> bool;
+	auto read_contents(std::string_view aff, std::string_view dic) -> void;
+	auto is_up_to_date() const -> bool;
+};
 
 struct Aff_Data {
 	static constexpr auto HIDDEN_HOMONYM_FLAG = char16_t(-1);
@@ -134,6 +576,7 @@ struct Aff_Data {
 	Substr_Replacer<wchar_t> input_substr_replacer;
 	std::wstring ignored_chars;
 	icu::Locale icu_locale;
+	Case_Table case_table;
 	Substr_Replacer<wchar_t> output_substr_replacer;
 
 	// suggestion options
@@ -170,6 +613,8 @@ struct Aff_Data {
 	std::wstring compound_syllable_vowels;
 	std::vector<Compound_Pattern<wchar_t>> compound_patterns;
 
+	Flag_Id_Map flag_ids;
+
 	// data members used only while parsing
 	Flag_Type flag_type;
 	Encoding encoding;
@@ -177,13 +622,23 @@ struct Aff_Data {
 	std::string wordchars; // deprecated?
 
 	auto parse_aff(std::istream& in) -> bool;
-	auto parse_dic(std::istream& in) -> bool;
+	auto parse_dic(std::istream& in, size_t num_threads = 0) -> bool;
 	auto parse_aff_dic(std::istream& aff, std::istream& dic)
 	{
 		if (parse_aff(aff))
 			return parse_dic(dic);
 		return false;
 	}
+	auto write_compiled(std::string_view aff_text,
+	                    const Dictionary_Source& source,
+	                    std::ostream& out) const -> bool;
+	auto static read_compiled_source(const char* data, size_t size,
+	                                 Dictionary_Source& source) -> bool;
+	auto static verify_compiled(const char* data, size_t size) -> bool;
+	auto parse_compiled(const char* data, size_t size,
+	                    std::shared_ptr<const void> owner) -> bool;
+	auto build_case_table() -> void;
+	auto compute_affix_properties() -> void;
 };
 } // namespace v3
 } // namespace nuspell
@@ -19,8 +19,11 @@
 #include "dictionary.hxx"
 #include "utils.hxx"
 
+#include <array>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
 #include <unicode/uchar.h>
@@ -52,6 +55,304 @@ class At_Scope_Exit {
 
 #define AT_SCOPE_EXIT(...) ASE_INTERNAL2(__COUNTER__, __VA_ARGS__)
 
+/**
+ * @brief Remembers the results of the compound search for the tails of one
+ * word.
+ *
+ * The search for a split of a compound reaches the same tail of the word
+ * through many different splits of its head. With this memo each tail is
+ * searched only once, so the search takes polynomial time instead of
+ * exponential.
+ *
+ * The search modifies the word temporarily, e.g. for simplified triples and
+ * for pattern replacements, so the tails are keyed on the content of the whole
+ * word too. The table keeps its memory between words and is reset in constant
+ * time by bumping the generation.
+ */
+class Compound_Memo {
+	struct Entry {
+		uint64_t key;
+		uint32_t generation;
+		Compounding_Result result;
+	};
+	bool active = false;
+	uint32_t generation = 0;
+	size_t num_states = 0;
+	size_t num_entries = 0;
+	vector<wstring> word_states;
+	vector<Entry> table = vector<Entry>(64);
+
+	auto slot(uint64_t key) -> Entry&
+	{
+		auto mask = table.size() - 1;
+		auto i = size_t(key * 0x9e3779b97f4a7c15 >> 32) & mask;
+		for (;; i = (i + 1) & mask) {
+			auto& e = table[i];
+			if (e.generation != generation || e.key == key)
+				return e;
+		}
+	}
+	auto grow() -> void
+	{
+		auto old = vector<Entry>(table.size() * 2);
+		old.swap(table);
+		for (auto& e : old)
+			if (e.generation == generation)
+				slot(e.key) = e;
+	}
+
+      public:
+	static constexpr auto NO_KEY = uint64_t(-1);
+
+	auto begin_word() -> bool
+	{
+		if (active)
+			return false;
+		if (++generation == 0) {
+			for (auto& e : table)
+				e.generation = 0;
+			generation = 1;
+		}
+		num_states = 0;
+		num_entries = 0;
+		active = true;
+		return true;
+	}
+	auto end_word() -> void { active = false; }
+
+	auto key(const wstring& word, size_t start_pos, size_t num_part,
+	         Affixing_Mode m, bool allow_bad_forceucase) -> uint64_t
+	{
+		if (!active || start_pos > 0xFFFF || num_part > 0xFFFF)
+			return NO_KEY;
+		auto states = begin(word_states);
+		auto it = std::find(states, states + num_states, word);
+		auto state = size_t(it - states);
+		if (state == num_states) {
+			if (state == 0xFF)
+				return NO_KEY;
+			if (state == word_states.size())
+				word_states.push_back(word);
+			else
+				word_states[state] = word;
+			++num_states;
+		}
+		return uint64_t(state) << 40 | uint64_t(start_pos) << 24 |
+		       uint64_t(num_part) << 8 | uint64_t(m) << 1 |
+		       allow_bad_forceucase;
+	}
+	auto find(uint64_t key) -> const Compounding_Result*
+	{
+		if (key == NO_KEY)
+			return nullptr;
+		auto& e = slot(key);
+		if (e.generation != generation)
+			return nullptr;
+		return &e.result;
+	}
+	auto add(uint64_t key, const Compounding_Result& r) -> void
+	{
+		if (key == NO_KEY)
+			return;
+		if (2 * (num_entries + 1) > table.size())
+			grow();
+		slot(key) = {key, generation, r};
+		++num_entries;
+	}
+};
+
+auto compound_memo() -> Compound_Memo&
+{
+	static thread_local Compound_Memo memo;
+	return memo;
+}
+
+/**
+ * @brief Keeps the compound memo of the calling thread active while one word
+ * is checked for compounding. Nested scopes leave it to the outermost one.
+ */
+class Compound_Memo_Scope {
+	bool started;
+
+      public:
+	Compound_Memo_Scope() : started(compound_memo().begin_word()) {}
+	~Compound_Memo_Scope()
+	{
+		if (started)
+			compound_memo().end_word();
+	}
+	Compound_Memo_Scope(const Compound_Memo_Scope&) = delete;
+	auto operator=(const Compound_Memo_Scope&)
+	    -> Compound_Memo_Scope& = delete;
+};
+
+/**
+ * @brief Counts the steps of the compound and suggestion searches done for one
+ * public spell or suggest call.
+ *
+ * There is one budget per thread. It is unlimited unless a Work_Budget_Scope
+ * with a nonzero limit is alive. When no steps are left the searches stop
+ * early and the call returns what it has found so far.
+ */
+class Work_Budget {
+	size_t steps_left = 0;
+	bool limited = false;
+	bool truncated = false;
+
+      public:
+	auto begin_call(size_t max_steps) -> void
+	{
+		steps_left = max_steps;
+		limited = max_steps != 0;
+		truncated = false;
+	}
+	auto end_call() -> void { limited = false; }
+
+	/**
+	 * @brief Takes one step.
+	 * @return false if the budget is exhausted.
+	 */
+	auto spend() -> bool
+	{
+		if (likely(!limited))
+			return true;
+		if (steps_left == 0) {
+			truncated = true;
+			return false;
+		}
+		--steps_left;
+		return true;
+	}
+	auto exhausted() const -> bool { return limited && steps_left == 0; }
+	auto was_truncated() const -> bool { return truncated; }
+};
+
+auto work_budget() -> Work_Budget&
+{
+	static thread_local Work_Budget budget;
+	return budget;
+}
+
+/**
+ * @brief Limits the work of the calling thread while it is alive.
+ */
+class Work_Budget_Scope {
+      public:
+	explicit Work_Budget_Scope(size_t max_steps)
+	{
+		work_budget().begin_call(max_steps);
+	}
+	~Work_Budget_Scope() { work_budget().end_call(); }
+	Work_Budget_Scope(const Work_Budget_Scope&) = delete;
+	auto operator=(const Work_Budget_Scope&)
+	    -> Work_Budget_Scope& = delete;
+};
+
+/**
+ * @brief Tells without a lookup that most heads of a compound can not be its
+ * first part.
+ *
+ * A head word[start_pos, i) is kept if a prefix can be stripped from it, if
+ * it is a word of the list, or if removing the appending of a suffix it ends
+ * with leaves a prefix of a word of the list. Every other head fails
+ * check_word_in_compound(), which strips at most one prefix and one suffix.
+ */
+class Compound_Part_Filter {
+	const Dict_Base& d;
+	wstring_view rest;
+	bool keep_all;
+	Word_List::Prefix_Match match;
+
+      public:
+	Compound_Part_Filter(const Dict_Base& d, wstring_view word,
+	                     size_t start_pos)
+	    : d(d), rest(word.substr(start_pos))
+	{
+		keep_all = !d.words.has_prefix_index() ||
+		           d.prefixes.iterate_prefixes_of(rest);
+		if (!keep_all)
+			match = d.words.match_prefixes(rest);
+	}
+	auto may_be_part(size_t len) const -> bool
+	{
+		if (keep_all || len >= 64 || (match.word_ends >> len & 1))
+			return true;
+		auto part = rest.substr(0, len);
+		for (auto& e : d.suffixes.iterate_suffixes_of(part))
+			if (len - e.appending.size() <= match.depth)
+				return true;
+		return false;
+	}
+};
+
+/**
+ * @brief Tells if the spelling pipeline @p st has a dictionary trait.
+ *
+ * The specialized pipelines know the trait at compile time, so the branches
+ * on it fold away. The generic pipeline returns @p value.
+ */
+template <unsigned char st>
+auto has_trait(Dict_Base::Spell_Traits trait, bool value) -> bool
+{
+	if constexpr (st == Dict_Base::GENERIC_SPELLING)
+		return value;
+	else
+		return st & trait;
+}
+
+using Spell_Break = bool (Dict_Base::*)(wstring&, size_t) const;
+
+/**
+ * @brief Returns the pipeline for the traits @p st.
+ *
+ * Only dictionaries without traits and those that only compound are common
+ * enough to pay for their own instantiation of the whole pipeline. The rest
+ * use the generic one.
+ */
+template <size_t st>
+constexpr auto spell_break_for_traits() -> Spell_Break
+{
+	if constexpr (st == 0 || st == Dict_Base::COMPOUNDING)
+		return &Dict_Base::spell_break<st>;
+	else
+		return &Dict_Base::spell_break<Dict_Base::GENERIC_SPELLING>;
+}
+
+template <size_t... st>
+constexpr auto make_spell_break_table(index_sequence<st...>)
+{
+	return array<Spell_Break, sizeof...(st)>{spell_break_for_traits<st>()...};
+}
+
+/**
+ * @brief Pipelines indexed by Dict_Base::spell_traits. Constant initialized,
+ * so it can be used during static initialization.
+ */
+constexpr auto spell_break_table = make_spell_break_table(
+    make_index_sequence<Dict_Base::GENERIC_SPELLING + 1>());
+
+/**
+ * @brief Picks the spelling pipeline specialized on the traits of the loaded
+ * dictionary and builds the indexes and affix properties it uses.
+ *
+ * Call it after the dictionary is filled, however that was done.
+ */
+auto Dict_Base::specialize_spelling() -> void
+{
+	compute_affix_properties();
+	if (compound_flag || compound_begin_flag || compound_middle_flag ||
+	    compound_last_flag)
+		words.build_prefix_index();
+	spell_traits = 0;
+	if (complex_prefixes)
+		spell_traits |= COMPLEX_PREFIXES;
+	if (compound_flag || compound_begin_flag || compound_middle_flag ||
+	    compound_last_flag || !compound_rules.empty())
+		spell_traits |= COMPOUNDING;
+	if (checksharps)
+		spell_traits |= CHECKSHARPS;
+}
+
 /**
  * @brief Check spelling for a word.
  *
@@ -84,12 +385,13 @@ auto Dict_Base::spell_priv(std::wstring& s) const -> bool
 	erase_chars(s, ignored_chars);
 
 	// handle break patterns
+	auto pipeline = spell_break_table[spell_traits];
 	auto copy = s;
-	auto ret = spell_break(s);
+	auto ret = (this->*pipeline)(s, 0);
 	assert(s == copy);
 	if (!ret && abbreviation) {
 		s += '.';
-		ret = spell_break(s);
+		ret = (this->*pipeline)(s, 0);
 	}
 	return ret;
 }
@@ -100,10 +402,11 @@ auto Dict_Base::spell_priv(std::wstring& s) const -> bool
  * @param s string to check spelling for.
  * @return The spelling result.
  */
+template <unsigned char st>
 auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 {
 	// check spelling accoring to case
-	auto res = spell_casing(s);
+	auto res = spell_casing<st>(s);
 	if (res) {
 		// handle forbidden words
 		if (res->contains(forbiddenword_flag)) {
@@ -121,7 +424,7 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 	for (auto& pat : break_table.start_word_breaks()) {
 		if (begins_with(s, pat)) {
 			auto substr = s.substr(pat.size());
-			auto res = spell_break(substr);
+			auto res = spell_break<st>(substr);
 			if (res)
 				return res;
 		}
@@ -131,7 +434,7 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 	for (auto& pat : break_table.end_word_breaks()) {
 		if (ends_with(s, pat)) {
 			auto substr = s.substr(0, s.size() - pat.size());
-			auto res = spell_break(substr);
+			auto res = spell_break<st>(substr);
 			if (res)
 				return res;
 		}
@@ -143,10 +446,10 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
 		if (i > 0 && i < s.size() - pat.size()) {
 			auto part1 = s.substr(0, i);
 			auto part2 = s.substr(i + pat.size());
-			auto res1 = spell_break(part1, depth + 1);
+			auto res1 = spell_break<st>(part1, depth + 1);
 			if (!res1)
 				continue;
-			auto res2 = spell_break(part2, depth + 1);
+			auto res2 = spell_break<st>(part2, depth + 1);
 			if (res2)
 				return res2;
 		}
@@ -161,22 +464,23 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
  * @param s string to check spelling for.
  * @return The spelling result.
  */
+template <unsigned char st>
 auto Dict_Base::spell_casing(std::wstring& s) const -> const Flag_Set*
 {
-	auto casing_type = classify_casing(s);
+	auto casing_type = case_table.classify_casing(s);
 	const Flag_Set* res = nullptr;
 
 	switch (casing_type) {
 	case Casing::SMALL:
 	case Casing::CAMEL:
 	case Casing::PASCAL:
-		res = check_word(s);
+		res = check_word<st>(s);
 		break;
 	case Casing::ALL_CAPITAL:
-		res = spell_casing_upper(s);
+		res = spell_casing_upper<st>(s);
 		break;
 	case Casing::INIT_CAPITAL:
-		res = spell_casing_title(s);
+		res = spell_casing_title<st>(s);
 		break;
 	}
 	return res;
@@ -188,11 +492,12 @@ auto Dict_Base::spell_casing(std::wstring& s) const -> const Flag_Set*
  * @param s string to check spelling for.
  * @return The flags of the corresponding dictionary word.
  */
+template <unsigned char st>
 auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
 {
 	auto& loc = icu_locale;
 
-	auto res = check_word(s, ALLOW_BAD_FORCEUCASE);
+	auto res = check_word<st>(s, ALLOW_BAD_FORCEUCASE);
 	if (res)
 		return res;
 
@@ -203,15 +508,15 @@ auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
 		// apostophe is at beginning of word or dividing the word
 		auto part1 = s.substr(0, apos + 1);
 		auto part2 = s.substr(apos + 1);
-		to_lower(part1, loc, part1);
-		to_title(part2, loc, part2);
+		case_table.to_lower(part1, loc, part1);
+		case_table.to_title(part2, loc, part2);
 		auto t = part1 + part2;
-		res = check_word(t, ALLOW_BAD_FORCEUCASE);
+		res = check_word<st>(t, ALLOW_BAD_FORCEUCASE);
 		if (res)
 			return res;
-		to_title(part1, loc, part1);
+		case_table.to_title(part1, loc, part1);
 		t = part1 + part2;
-		res = check_word(t, ALLOW_BAD_FORCEUCASE);
+		res = check_word<st>(t, ALLOW_BAD_FORCEUCASE);
 		if (res)
 			return res;
 	}
@@ -220,24 +525,25 @@ auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
 	AT_SCOPE_EXIT(s = backup);
 
 	// handle sharp s for German
-	if (checksharps && s.find(L"SS") != s.npos) {
-		to_lower(backup, loc, s);
-		res = spell_sharps(s);
+	if (has_trait<st>(CHECKSHARPS, checksharps) &&
+	    s.find(L"SS") != s.npos) {
+		case_table.to_lower(backup, loc, s);
+		res = spell_sharps<st>(s);
 		if (res)
 			return res;
 
-		to_title(backup, loc, s);
-		res = spell_sharps(s);
+		case_table.to_title(backup, loc, s);
+		res = spell_sharps<st>(s);
 		if (res)
 			return res;
 	}
-	to_title(backup, loc, s);
-	res = check_word(s, ALLOW_BAD_FORCEUCASE);
+	case_table.to_title(backup, loc, s);
+	res = check_word<st>(s, ALLOW_BAD_FORCEUCASE);
 	if (res && !res->contains(keepcase_flag))
 		return res;
 
-	to_lower(backup, loc, s);
-	res = check_word(s, ALLOW_BAD_FORCEUCASE);
+	case_table.to_lower(backup, loc, s);
+	res = check_word<st>(s, ALLOW_BAD_FORCEUCASE);
 	if (res && !res->contains(keepcase_flag))
 		return res;
 	return nullptr;
@@ -249,22 +555,24 @@ auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
  * @param s string to check spelling for.
  * @return The flags of the corresponding dictionary word.
  */
+template <unsigned char st>
 auto Dict_Base::spell_casing_title(std::wstring& s) const -> const Flag_Set*
 {
 	auto& loc = icu_locale;
 
 	// check title case
-	auto res = check_word(s, ALLOW_BAD_FORCEUCASE, SKIP_HIDDEN_HOMONYM);
+	auto res = check_word<st>(s, ALLOW_BAD_FORCEUCASE, SKIP_HIDDEN_HOMONYM);
 	if (res)
 		return res;
 
 	auto backup = Short_WString(s);
-	to_lower(backup, loc, s);
-	res = check_word(s, ALLOW_BAD_FORCEUCASE);
+	case_table.to_lower(backup, loc, s);
+	res = check_word<st>(s, ALLOW_BAD_FORCEUCASE);
 
 	// with CHECKSHARPS, ß is allowed too in KEEPCASE words with title case
 	if (res && res->contains(keepcase_flag) &&
-	    !(checksharps && (s.find(L'\xDF') != s.npos))) {
+	    !(has_trait<st>(CHECKSHARPS, checksharps) &&
+	      s.find(L'\xDF') != s.npos)) {
 		res = nullptr;
 	}
 	s = backup;
@@ -287,25 +595,28 @@ auto Dict_Base::spell_casing_title(std::wstring& s) const -> const Flag_Set*
  * @param rep counter for the number of replacements done.
  * @return The flags of the corresponding dictionary word.
  */
+template <unsigned char st>
 auto Dict_Base::spell_sharps(std::wstring& base, size_t pos, size_t n,
                              size_t rep) const -> const Flag_Set*
 {
 	const size_t MAX_SHARPS = 5;
+	if (!work_budget().spend())
+		return nullptr;
 	pos = base.find(L"ss", pos);
 	if (pos != std::string::npos && n < MAX_SHARPS) {
 		base[pos] = L'\xDF'; // ß
 		base.erase(pos + 1, 1);
-		auto res = spell_sharps(base, pos + 1, n + 1, rep + 1);
+		auto res = spell_sharps<st>(base, pos + 1, n + 1, rep + 1);
 		base[pos] = 's';
 		base.insert(pos + 1, 1, 's');
 		if (res)
 			return res;
-		res = spell_sharps(base, pos + 2, n + 1, rep);
+		res = spell_sharps<st>(base, pos + 2, n + 1, rep);
 		if (res)
 			return res;
 	}
 	else if (rep > 0) {
-		return check_word(base, ALLOW_BAD_FORCEUCASE);
+		return check_word<st>(base, ALLOW_BAD_FORCEUCASE);
 	}
 	return nullptr;
 }
@@ -320,28 +631,42 @@ auto Dict_Base::spell_sharps(std::wstring& base, size_t pos, size_t n,
  * @param s string to check spelling for.
  * @return The flags of the corresponding dictionary word.
  */
+template <unsigned char st>
 auto Dict_Base::check_word(std::wstring& s, Forceucase allow_bad_forceucase,
                            Hidden_Homonym skip_hidden_homonym) const
     -> const Flag_Set*
 {
 
-	auto ret1 = check_simple_word(s, skip_hidden_homonym);
+	auto ret1 = check_simple_word<st>(s, skip_hidden_homonym);
 	if (ret1)
 		return ret1;
-	auto ret2 = check_compound(s, allow_bad_forceucase);
-	if (ret2)
-		return &ret2->second;
-
+	if constexpr (st == GENERIC_SPELLING || st & COMPOUNDING) {
+		auto ret2 = check_compound(s, allow_bad_forceucase);
+		if (ret2)
+			return ret2->second;
+	}
 	return nullptr;
 }
 
+/**
+ * @brief Copies @p word to a buffer with enough room for stripping up to three
+ * affixes from it.
+ */
+auto Dict_Base::root_buffer(std::wstring_view word) const
+    -> Root_Buffer<wchar_t>
+{
+	return {word, 3 * prefixes.max_stripping_size(),
+	        3 * suffixes.max_stripping_size()};
+}
+
+template <unsigned char st>
 auto Dict_Base::check_simple_word(std::wstring& s,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> const Flag_Set*
 {
 
 	for (auto& we : make_iterator_range(words.equal_range(s))) {
-		auto& word_flags = we.second;
+		auto& word_flags = *we.second;
 		if (word_flags.contains(need_affix_flag))
 			continue;
 		if (word_flags.contains(compound_onlyin_flag))
@@ -351,58 +676,61 @@ auto Dict_Base::check_simple_word(std::wstring& s,
 			continue;
 		return &word_flags;
 	}
+	auto root = root_buffer(s);
 	{
-		auto ret3 = strip_suffix_only(s, skip_hidden_homonym);
+		auto ret3 = strip_suffix_only(root, skip_hidden_homonym);
 		if (ret3)
-			return &ret3->second;
+			return ret3->second;
 	}
 	{
-		auto ret2 = strip_prefix_only(s, skip_hidden_homonym);
+		auto ret2 = strip_prefix_only(root, skip_hidden_homonym);
 		if (ret2)
-			return &ret2->second;
+			return ret2->second;
 	}
 	{
 		auto ret4 = strip_prefix_then_suffix_commutative(
-		    s, skip_hidden_homonym);
+		    root, skip_hidden_homonym);
 		if (ret4)
-			return &ret4->second;
+			return ret4->second;
 	}
-	if (!complex_prefixes) {
-		auto ret6 = strip_suffix_then_suffix(s, skip_hidden_homonym);
+	if (!has_trait<st>(COMPLEX_PREFIXES, complex_prefixes)) {
+		auto ret6 = strip_suffix_then_suffix(root, skip_hidden_homonym);
 		if (ret6)
-			return &ret6->second;
+			return ret6->second;
 
 		auto ret7 =
-		    strip_prefix_then_2_suffixes(s, skip_hidden_homonym);
+		    strip_prefix_then_2_suffixes(root, skip_hidden_homonym);
 		if (ret7)
-			return &ret7->second;
+			return ret7->second;
 
-		auto ret8 = strip_suffix_prefix_suffix(s, skip_hidden_homonym);
+		auto ret8 =
+		    strip_suffix_prefix_suffix(root, skip_hidden_homonym);
 		if (ret8)
-			return &ret8->second;
+			return ret8->second;
 
 		// this is slow and unused so comment
-		// auto ret9 = strip_2_suffixes_then_prefix(s,
+		// auto ret9 = strip_2_suffixes_then_prefix(root,
 		// skip_hidden_homonym); if (ret9)
-		//	return &ret9->second;
+		//	return ret9->second;
 	}
 	else {
-		auto ret6 = strip_prefix_then_prefix(s, skip_hidden_homonym);
+		auto ret6 = strip_prefix_then_prefix(root, skip_hidden_homonym);
 		if (ret6)
-			return &ret6->second;
+			return ret6->second;
 		auto ret7 =
-		    strip_suffix_then_2_prefixes(s, skip_hidden_homonym);
+		    strip_suffix_then_2_prefixes(root, skip_hidden_homonym);
 		if (ret7)
-			return &ret7->second;
+			return ret7->second;
 
-		auto ret8 = strip_prefix_suffix_prefix(s, skip_hidden_homonym);
+		auto ret8 =
+		    strip_prefix_suffix_prefix(root, skip_hidden_homonym);
 		if (ret8)
-			return &ret8->second;
+			return ret8->second;
 
 		// this is slow and unused so comment
-		// auto ret9 = strip_2_prefixes_then_suffix(s,
+		// auto ret9 = strip_2_prefixes_then_suffix(root,
 		// skip_hidden_homonym); if (ret9)
-		//	return &ret9->second;
+		//	return ret9->second;
 	}
 	return nullptr;
 }
@@ -411,11 +739,11 @@ template <class AffixT>
 class To_Root_Unroot_RAII {
       private:
 	using value_type = typename AffixT::value_type;
-	basic_string<value_type>& word;
+	Root_Buffer<value_type>& word;
 	const AffixT& affix;
 
       public:
-	To_Root_Unroot_RAII(basic_string<value_type>& w, const AffixT& a)
+	To_Root_Unroot_RAII(Root_Buffer<value_type>& w, const AffixT& a)
 	    : word(w), affix(a)
 	{
 		affix.to_root(word);
@@ -423,43 +751,38 @@ class To_Root_Unroot_RAII {
 	~To_Root_Unroot_RAII() { affix.to_derived(word); }
 };
 
-template <Affixing_Mode m>
-auto Dict_Base::affix_NOT_valid(const Prefix<wchar_t>& e) const
+/**
+ * @brief Hash of @p root, derived from the hash of the word it was stripped
+ * from by To_Root_Unroot_RAII in O(affix length).
+ */
+auto root_hash(uint64_t word_hash, wstring_view root, const Prefix<wchar_t>& e)
+    -> size_t
 {
-	if (m == FULL_WORD && e.cont_flags.contains(compound_onlyin_flag))
-		return true;
-	if (m == AT_COMPOUND_END &&
-	    !e.cont_flags.contains(compound_permit_flag))
-		return true;
-	if (m != FULL_WORD && e.cont_flags.contains(compound_forbid_flag))
-		return true;
-	return false;
+	auto rest_size = root.size() - e.stripping.size();
+	return Word_List::hasher::replace_prefix(word_hash, e.appending,
+	                                         e.stripping, rest_size);
 }
-template <Affixing_Mode m>
-auto Dict_Base::affix_NOT_valid(const Suffix<wchar_t>& e) const
+auto root_hash(uint64_t word_hash, wstring_view, const Suffix<wchar_t>& e)
+    -> size_t
 {
-	if (m == FULL_WORD && e.cont_flags.contains(compound_onlyin_flag))
-		return true;
-	if (m == AT_COMPOUND_BEGIN &&
-	    !e.cont_flags.contains(compound_permit_flag))
-		return true;
-	if (m != FULL_WORD && e.cont_flags.contains(compound_forbid_flag))
-		return true;
-	return false;
+	return Word_List::hasher::replace_suffix(word_hash, e.appending,
+	                                         e.stripping);
+}
+
+template <Affixing_Mode m, class AffixT>
+auto Dict_Base::affix_NOT_valid(const AffixT& e) const
+{
+	return (e.properties & NOT_VALID << m) != 0;
 }
 template <Affixing_Mode m, class AffixT>
 auto Dict_Base::outer_affix_NOT_valid(const AffixT& e) const
 {
-	if (affix_NOT_valid<m>(e))
-		return true;
-	if (e.cont_flags.contains(need_affix_flag))
-		return true;
-	return false;
+	return (e.properties & (NOT_VALID << m | NEEDS_AFFIX)) != 0;
 }
 template <class AffixT>
 auto Dict_Base::is_circumfix(const AffixT& a) const
 {
-	return a.cont_flags.contains(circumfix_flag);
+	return (a.properties & IS_CIRCUMFIX) != 0;
 }
 
 template <class AffixInner, class AffixOuter>
@@ -488,13 +811,19 @@ auto Dict_Base::is_valid_inside_compound(const Flag_Set& flags) const
 		return false;
 	return true;
 }
+template <Affixing_Mode m, class AffixT>
+auto Dict_Base::is_valid_inside_compound(const AffixT& e) const
+{
+	return (e.properties & VALID_INSIDE_COMPOUND << m) != 0;
+}
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_prefix_only(std::wstring& word,
+auto Dict_Base::strip_prefix_only(Root_Buffer<wchar_t>& word,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& e = *it;
@@ -505,9 +834,10 @@ auto Dict_Base::strip_prefix_only(std::wstring& word,
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, e);
 		if (!e.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, e);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
 			// badflag check
@@ -519,7 +849,7 @@ auto Dict_Base::strip_prefix_only(std::wstring& word,
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(e.cont_flags))
+			    !is_valid_inside_compound<m>(e))
 				continue;
 			return {word_entry, e};
 		}
@@ -528,26 +858,28 @@ auto Dict_Base::strip_prefix_only(std::wstring& word,
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::strip_suffix_only(std::wstring& word,
+auto Dict_Base::strip_suffix_only(Root_Buffer<wchar_t>& word,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& e = *it;
 		if (outer_affix_NOT_valid<m>(e))
 			continue;
 		if (e.appending.size() != 0 && m == AT_COMPOUND_END &&
-		    e.cont_flags.contains(compound_onlyin_flag))
+		    e.properties & IS_COMPOUND_ONLY)
 			continue;
 		if (is_circumfix(e))
 			continue;
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, e);
 		if (!e.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, e);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
 			// badflag check
@@ -559,7 +891,7 @@ auto Dict_Base::strip_suffix_only(std::wstring& word,
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(e.cont_flags))
+			    !is_valid_inside_compound<m>(e))
 				continue;
 			return {word_entry, e};
 		}
@@ -569,7 +901,7 @@ auto Dict_Base::strip_suffix_only(std::wstring& word,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_prefix_then_suffix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
 {
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
@@ -591,11 +923,12 @@ auto Dict_Base::strip_prefix_then_suffix(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
-                                     std::wstring& word,
+                                     Root_Buffer<wchar_t>& word,
                                      Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se = *it;
@@ -608,9 +941,10 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se);
 		if (!se.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, se);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se, pe) &&
 			    !cross_valid_inner_outer(word_flags, pe))
 				continue;
@@ -625,8 +959,8 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(se.cont_flags) &&
-			    !is_valid_inside_compound<m>(pe.cont_flags))
+			    !is_valid_inside_compound<m>(se) &&
+			    !is_valid_inside_compound<m>(pe))
 				continue;
 			return {word_entry, se, pe};
 		}
@@ -637,7 +971,7 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_suffix_then_prefix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>>
 {
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
@@ -659,11 +993,12 @@ auto Dict_Base::strip_suffix_then_prefix(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
-                                     std::wstring& word,
+                                     Root_Buffer<wchar_t>& word,
                                      Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe = *it;
@@ -676,9 +1011,10 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe);
 		if (!pe.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, pe);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe, se) &&
 			    !cross_valid_inner_outer(word_flags, se))
 				continue;
@@ -693,8 +1029,8 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(se.cont_flags) &&
-			    !is_valid_inside_compound<m>(pe.cont_flags))
+			    !is_valid_inside_compound<m>(se) &&
+			    !is_valid_inside_compound<m>(pe))
 				continue;
 			return {word_entry, pe, se};
 		}
@@ -704,7 +1040,7 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_prefix_then_suffix_commutative(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
 {
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
@@ -726,12 +1062,13 @@ auto Dict_Base::strip_prefix_then_suffix_commutative(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_pfx_then_sfx_comm_2(
-    const Prefix<wchar_t>& pe, std::wstring& word,
+    const Prefix<wchar_t>& pe, Root_Buffer<wchar_t>& word,
     Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
 {
 	auto& dic = words;
-	auto has_needaffix_pe = pe.cont_flags.contains(need_affix_flag);
+	auto word_hash = Word_List::hasher::hash(word);
+	auto has_needaffix_pe = (pe.properties & NEEDS_AFFIX) != 0;
 	auto is_circumfix_pe = is_circumfix(pe);
 
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
@@ -740,7 +1077,7 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(
 			continue;
 		if (affix_NOT_valid<m>(se))
 			continue;
-		auto has_needaffix_se = se.cont_flags.contains(need_affix_flag);
+		auto has_needaffix_se = (se.properties & NEEDS_AFFIX) != 0;
 		if (has_needaffix_pe && has_needaffix_se)
 			continue;
 		if (is_circumfix_pe != is_circumfix(se))
@@ -748,9 +1085,10 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se);
 		if (!se.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, se);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 
 			auto valid_cross_pe_outer =
 			    !has_needaffix_pe &&
@@ -776,8 +1114,8 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(se.cont_flags) &&
-			    !is_valid_inside_compound<m>(pe.cont_flags))
+			    !is_valid_inside_compound<m>(se) &&
+			    !is_valid_inside_compound<m>(pe))
 				continue;
 			return {word_entry, se, pe};
 		}
@@ -788,7 +1126,7 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_suffix_then_suffix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>
 {
 	// The following check is purely for performance, it does not change
@@ -820,17 +1158,17 @@ auto Dict_Base::strip_suffix_then_suffix(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
-                                     std::wstring& word,
+                                     Root_Buffer<wchar_t>& word,
                                      Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>
 {
 
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
-		auto& se2 = *it;
-		if (!cross_valid_inner_outer(se2, se1))
-			continue;
+	for (auto it = suffixes.iterate_suffixes_of(word, se1.flag); it;
+	     ++it) {
+		auto& se2 = **it;
 		if (affix_NOT_valid<m>(se2))
 			continue;
 		if (is_circumfix(se2))
@@ -838,9 +1176,10 @@ auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se2);
 		if (!se2.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, se2);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, se2))
 				continue;
 			// badflag check
@@ -859,7 +1198,7 @@ auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_prefix_then_prefix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>
 {
 	// The following check is purely for performance, it does not change
@@ -890,16 +1229,16 @@ auto Dict_Base::strip_prefix_then_prefix(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
-                                     std::wstring& word,
+                                     Root_Buffer<wchar_t>& word,
                                      Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
-		auto& pe2 = *it;
-		if (!cross_valid_inner_outer(pe2, pe1))
-			continue;
+	for (auto it = prefixes.iterate_prefixes_of(word, pe1.flag); it;
+	     ++it) {
+		auto& pe2 = **it;
 		if (affix_NOT_valid<m>(pe2))
 			continue;
 		if (is_circumfix(pe2))
@@ -907,9 +1246,10 @@ auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe2);
 		if (!pe2.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, pe2);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, pe2))
 				continue;
 			// badflag check
@@ -928,7 +1268,7 @@ auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_prefix_then_2_suffixes(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	// The following check is purely for performance, it does not change
@@ -974,16 +1314,16 @@ auto Dict_Base::strip_prefix_then_2_suffixes(
 template <Affixing_Mode m>
 auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
                                   const Suffix<wchar_t>& se1,
-                                  std::wstring& word,
+                                  Root_Buffer<wchar_t>& word,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
-	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
-		auto& se2 = *it;
-		if (!cross_valid_inner_outer(se2, se1))
-			continue;
+	for (auto it = suffixes.iterate_suffixes_of(word, se1.flag); it;
+	     ++it) {
+		auto& se2 = **it;
 		if (affix_NOT_valid<m>(se2))
 			continue;
 		if (is_circumfix(se2))
@@ -991,9 +1331,10 @@ auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se2);
 		if (!se2.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, se2);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se1, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
 				continue;
@@ -1016,7 +1357,7 @@ auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_suffix_prefix_suffix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	// The following check is purely for performance, it does not change
@@ -1061,11 +1402,13 @@ auto Dict_Base::strip_suffix_prefix_suffix(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
-                              const Prefix<wchar_t>& pe1, std::wstring& word,
+                              const Prefix<wchar_t>& pe1,
+                              Root_Buffer<wchar_t>& word,
                               Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
@@ -1085,9 +1428,10 @@ auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se2);
 		if (!se2.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, se2);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se2, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
 				continue;
@@ -1110,7 +1454,7 @@ auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_2_suffixes_then_prefix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	// The following check is purely for performance, it does not change
@@ -1156,11 +1500,12 @@ auto Dict_Base::strip_2_suffixes_then_prefix(
 template <Affixing_Mode m>
 auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
                                   const Suffix<wchar_t>& se2,
-                                  std::wstring& word,
+                                  Root_Buffer<wchar_t>& word,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe1 = *it;
@@ -1176,9 +1521,10 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe1);
 		if (!pe1.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, pe1);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe1, se2) &&
 			    !cross_valid_inner_outer(word_flags, se2))
 				continue;
@@ -1201,7 +1547,7 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_suffix_then_2_prefixes(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	// The following check is purely for performance, it does not change
@@ -1247,16 +1593,16 @@ auto Dict_Base::strip_suffix_then_2_prefixes(
 template <Affixing_Mode m>
 auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
                                   const Prefix<wchar_t>& pe1,
-                                  std::wstring& word,
+                                  Root_Buffer<wchar_t>& word,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
-	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
-		auto& pe2 = *it;
-		if (!cross_valid_inner_outer(pe2, pe1))
-			continue;
+	for (auto it = prefixes.iterate_prefixes_of(word, pe1.flag); it;
+	     ++it) {
+		auto& pe2 = **it;
 		if (affix_NOT_valid<m>(pe2))
 			continue;
 		if (is_circumfix(pe2))
@@ -1264,9 +1610,10 @@ auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe2);
 		if (!pe2.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, pe2);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe1, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
 				continue;
@@ -1288,7 +1635,7 @@ auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_prefix_suffix_prefix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	// The following check is purely for performance, it does not change
@@ -1333,11 +1680,13 @@ auto Dict_Base::strip_prefix_suffix_prefix(
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
-                              const Suffix<wchar_t>& se1, std::wstring& word,
+                              const Suffix<wchar_t>& se1,
+                              Root_Buffer<wchar_t>& word,
                               Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
@@ -1357,9 +1706,10 @@ auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 		To_Root_Unroot_RAII<Prefix<wchar_t>> xxx(word, pe2);
 		if (!pe2.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, pe2);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe2, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
 				continue;
@@ -1381,7 +1731,7 @@ auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 
 template <Affixing_Mode m>
 auto Dict_Base::strip_2_prefixes_then_suffix(
-    std::wstring& word, Hidden_Homonym skip_hidden_homonym) const
+    Root_Buffer<wchar_t>& word, Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	// The following check is purely for performance, it does not change
@@ -1427,11 +1777,12 @@ auto Dict_Base::strip_2_prefixes_then_suffix(
 template <Affixing_Mode m>
 auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
                                   const Prefix<wchar_t>& pe2,
-                                  std::wstring& word,
+                                  Root_Buffer<wchar_t>& word,
                                   Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
 	auto& dic = words;
+	auto word_hash = Word_List::hasher::hash(word);
 
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se1 = *it;
@@ -1447,9 +1798,10 @@ auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
 		To_Root_Unroot_RAII<Suffix<wchar_t>> xxx(word, se1);
 		if (!se1.check_condition(word))
 			continue;
+		auto h = root_hash(word_hash, word, se1);
 		for (auto& word_entry :
-		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		     make_iterator_range(dic.equal_range(word, h))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se1, pe2) &&
 			    !cross_valid_inner_outer(word_flags, pe2))
 				continue;
@@ -1480,10 +1832,10 @@ auto match_compound_pattern(const Compound_Pattern<wchar_t>& p,
 	                 p.begin_end_chars.str()) != 0)
 		return false;
 	if (p.first_word_flag != 0 &&
-	    !first->second.contains(p.first_word_flag))
+	    !first->second->contains(p.first_word_flag))
 		return false;
 	if (p.second_word_flag != 0 &&
-	    !second->second.contains(p.second_word_flag))
+	    !second->second->contains(p.second_word_flag))
 		return false;
 	if (p.match_first_only_unaffixed_or_zero_affixed &&
 	    first.affixed_and_modified)
@@ -1505,6 +1857,7 @@ auto Dict_Base::check_compound(std::wstring& word,
     -> Compounding_Result
 {
 	auto part = std::wstring();
+	auto memo_scope = Compound_Memo_Scope();
 
 	if (compound_flag || compound_begin_flag || compound_middle_flag ||
 	    compound_last_flag) {
@@ -1514,8 +1867,10 @@ auto Dict_Base::check_compound(std::wstring& word,
 			return ret;
 	}
 	if (!compound_rules.empty()) {
-		auto words_data = vector<const Flag_Set*>();
-		return check_compound_with_rules(word, words_data, 0, part,
+		auto state_size = compound_rules.state_size();
+		auto rule_states = vector<uint64_t>(state_size);
+		compound_rules.initial_state(rule_states.data());
+		return check_compound_with_rules(word, rule_states, 0, part,
 		                                 allow_bad_forceucase);
 	}
 
@@ -1533,22 +1888,41 @@ auto Dict_Base::check_compound(std::wstring& word, size_t start_pos,
 		min_length = compound_min_length;
 	if (word.size() < min_length * 2)
 		return {};
+	if (!work_budget().spend())
+		return {};
+
+	// Only the tails reached by recursion can repeat. num_part matters
+	// only for the limit of words.
+	auto& memo = compound_memo();
+	auto key = Compound_Memo::NO_KEY;
+	if (m == AT_COMPOUND_MIDDLE)
+		key = memo.key(word, start_pos,
+		               compound_max_word_count ? num_part : 0, m,
+		               allow_bad_forceucase);
+	if (auto cached = memo.find(key))
+		return *cached;
+
+	auto ret = Compounding_Result();
+	auto part_filter = Compound_Part_Filter(*this, word, start_pos);
 	size_t max_length = word.size() - min_length;
 	for (auto i = start_pos + min_length; i <= max_length; ++i) {
 
-		auto part1_entry = check_compound_classic<m>(
-		    word, start_pos, i, num_part, part, allow_bad_forceucase);
-
-		if (part1_entry)
-			return part1_entry;
+		if (part_filter.may_be_part(i - start_pos)) {
+			ret = check_compound_classic<m>(word, start_pos, i,
+			                                num_part, part,
+			                                allow_bad_forceucase);
+			if (ret)
+				break;
+		}
 
-		part1_entry = check_compound_with_pattern_replacements<m>(
+		ret = check_compound_with_pattern_replacements<m>(
 		    word, start_pos, i, num_part, part, allow_bad_forceucase);
 
-		if (part1_entry)
-			return part1_entry;
+		if (ret)
+			break;
 	}
-	return {};
+	memo.add(key, ret);
+	return ret;
 }
 
 template <Affixing_Mode m>
@@ -1563,7 +1937,7 @@ auto Dict_Base::check_compound_classic(std::wstring& word, size_t start_pos,
 	auto part1_entry = check_word_in_compound<m>(part);
 	if (!part1_entry)
 		return {};
-	if (part1_entry->second.contains(forbiddenword_flag))
+	if (part1_entry->second->contains(forbiddenword_flag))
 		return {};
 	if (compound_check_triple) {
 		if (word[i - 1] == word[i]) {
@@ -1578,13 +1952,13 @@ auto Dict_Base::check_compound_classic(std::wstring& word, size_t start_pos,
 		return {};
 	num_part += part1_entry.num_words_modifier;
 	num_part += compound_root_flag &&
-	            part1_entry->second.contains(compound_root_flag);
+	            part1_entry->second->contains(compound_root_flag);
 
 	part.assign(word, i, word.npos);
 	auto part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 	if (!part2_entry)
 		goto try_recursive;
-	if (part2_entry->second.contains(forbiddenword_flag))
+	if (part2_entry->second->contains(forbiddenword_flag))
 		goto try_recursive;
 	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
 	                                      part1_entry, part2_entry))
@@ -1597,13 +1971,13 @@ auto Dict_Base::check_compound_classic(std::wstring& word, size_t start_pos,
 			goto try_recursive;
 	}
 	if (compound_force_uppercase && !allow_bad_forceucase &&
-	    part2_entry->second.contains(compound_force_uppercase))
+	    part2_entry->second->contains(compound_force_uppercase))
 		goto try_recursive;
 
 	old_num_part = num_part;
 	num_part += part2_entry.num_words_modifier;
 	num_part += compound_root_flag &&
-	            part2_entry->second.contains(compound_root_flag);
+	            part2_entry->second->contains(compound_root_flag);
 	if (compound_max_word_count != 0 &&
 	    num_part + 1 >= compound_max_word_count) {
 		if (compound_syllable_vowels.empty()) // is not Hungarian
@@ -1634,7 +2008,7 @@ try_recursive:
 		if (is_rep_similar(part))
 			goto try_simplified_triple;
 		auto& p2word = part2_entry->first;
-		if (word.compare(i, p2word.size(), p2word) == 0) {
+		if (wstring_view(word).substr(i, p2word.size()) == p2word) {
 			// part.assign(word, start_pos,
 			//            i - start_pos + p2word.size());
 			// The erase() is equivaled as the assign above.
@@ -1656,7 +2030,7 @@ try_simplified_triple:
 	part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 	if (!part2_entry)
 		goto try_simplified_triple_recursive;
-	if (part2_entry->second.contains(forbiddenword_flag))
+	if (part2_entry->second->contains(forbiddenword_flag))
 		goto try_simplified_triple_recursive;
 	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
 	                                      part1_entry, part2_entry))
@@ -1674,7 +2048,7 @@ try_simplified_triple:
 			goto try_simplified_triple_recursive;
 	}
 	if (compound_force_uppercase && !allow_bad_forceucase &&
-	    part2_entry->second.contains(compound_force_uppercase))
+	    part2_entry->second->contains(compound_force_uppercase))
 		goto try_simplified_triple_recursive;
 
 	if (compound_max_word_count != 0 &&
@@ -1698,7 +2072,7 @@ try_simplified_triple_recursive:
 		if (is_rep_similar(part))
 			return {};
 		auto& p2word = part2_entry->first;
-		if (word.compare(i, p2word.size(), p2word) == 0) {
+		if (wstring_view(word).substr(i, p2word.size()) == p2word) {
 			part.assign(word, start_pos,
 			            i - start_pos + p2word.size());
 			part.erase(i - start_pos, 1); // for the added char
@@ -1734,10 +2108,10 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 		auto part1_entry = check_word_in_compound<m>(part);
 		if (!part1_entry)
 			continue;
-		if (part1_entry->second.contains(forbiddenword_flag))
+		if (part1_entry->second->contains(forbiddenword_flag))
 			continue;
 		if (p.first_word_flag != 0 &&
-		    !part1_entry->second.contains(p.first_word_flag))
+		    !part1_entry->second->contains(p.first_word_flag))
 			continue;
 		if (compound_check_triple) {
 			if (word[i - 1] == word[i]) {
@@ -1754,10 +2128,10 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 		    check_word_in_compound<AT_COMPOUND_END>(part);
 		if (!part2_entry)
 			goto try_recursive;
-		if (part2_entry->second.contains(forbiddenword_flag))
+		if (part2_entry->second->contains(forbiddenword_flag))
 			goto try_recursive;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			goto try_recursive;
 		if (compound_check_duplicate && part1_entry == part2_entry)
 			goto try_recursive;
@@ -1770,7 +2144,7 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 				goto try_recursive;
 		}
 		if (compound_force_uppercase && !allow_bad_forceucase &&
-		    part2_entry->second.contains(compound_force_uppercase))
+		    part2_entry->second->contains(compound_force_uppercase))
 			goto try_recursive;
 
 		if (compound_max_word_count != 0 &&
@@ -1784,7 +2158,7 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 		if (!part2_entry)
 			goto try_simplified_triple;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			goto try_simplified_triple;
 		// if (compound_check_duplicate && part1_entry == part2_entry)
 		//	goto try_simplified_triple;
@@ -1796,7 +2170,8 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 			if (is_rep_similar(part))
 				goto try_simplified_triple;
 			auto& p2word = part2_entry->first;
-			if (word.compare(i, p2word.size(), p2word) == 0) {
+			if (wstring_view(word).substr(i, p2word.size()) ==
+			    p2word) {
 				part.assign(word, start_pos,
 				            i - start_pos + p2word.size());
 				if (is_rep_similar(part))
@@ -1816,10 +2191,10 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 		part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 		if (!part2_entry)
 			goto try_simplified_triple_recursive;
-		if (part2_entry->second.contains(forbiddenword_flag))
+		if (part2_entry->second->contains(forbiddenword_flag))
 			goto try_simplified_triple_recursive;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			goto try_simplified_triple_recursive;
 		if (compound_check_duplicate && part1_entry == part2_entry)
 			goto try_simplified_triple_recursive;
@@ -1833,7 +2208,7 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 				goto try_simplified_triple_recursive;
 		}
 		if (compound_force_uppercase && !allow_bad_forceucase &&
-		    part2_entry->second.contains(compound_force_uppercase))
+		    part2_entry->second->contains(compound_force_uppercase))
 			goto try_simplified_triple_recursive;
 
 		if (compound_max_word_count != 0 &&
@@ -1847,7 +2222,7 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 		if (!part2_entry)
 			continue;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			continue;
 		// if (compound_check_duplicate && part1_entry == part2_entry)
 		//	continue;
@@ -1860,7 +2235,8 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 			if (is_rep_similar(part))
 				continue;
 			auto& p2word = part2_entry->first;
-			if (word.compare(i, p2word.size(), p2word) == 0) {
+			if (wstring_view(word).substr(i, p2word.size()) ==
+			    p2word) {
 				part.assign(word, start_pos,
 				            i - start_pos + p2word.size());
 				part.erase(i - start_pos,
@@ -1894,7 +2270,7 @@ auto Dict_Base::check_word_in_compound(std::wstring& word) const
 
 	auto range = words.equal_range(word);
 	for (auto& we : make_iterator_range(range)) {
-		auto& word_flags = we.second;
+		auto& word_flags = *we.second;
 		if (word_flags.contains(need_affix_flag))
 			continue;
 		if (!word_flags.contains(compound_flag) &&
@@ -1905,20 +2281,21 @@ auto Dict_Base::check_word_in_compound(std::wstring& word) const
 		auto num_syllable_mod = calc_syllable_modifier<m>(we);
 		return {&we, 0, num_syllable_mod};
 	}
-	auto x2 = strip_suffix_only<m>(word, SKIP_HIDDEN_HOMONYM);
+	auto root = root_buffer(word);
+	auto x2 = strip_suffix_only<m>(root, SKIP_HIDDEN_HOMONYM);
 	if (x2) {
 		auto num_syllable_mod = calc_syllable_modifier<m>(*x2, *x2.a);
 		return {x2, 0, num_syllable_mod, is_modiying_affix(*x2.a)};
 	}
 
-	auto x1 = strip_prefix_only<m>(word, SKIP_HIDDEN_HOMONYM);
+	auto x1 = strip_prefix_only<m>(root, SKIP_HIDDEN_HOMONYM);
 	if (x1) {
 		auto num_words_mod = calc_num_words_modifier(*x1.a);
 		return {x1, num_words_mod, 0, is_modiying_affix(*x1.a)};
 	}
 
 	auto x3 =
-	    strip_prefix_then_suffix_commutative<m>(word, SKIP_HIDDEN_HOMONYM);
+	    strip_prefix_then_suffix_commutative<m>(root, SKIP_HIDDEN_HOMONYM);
 	if (x3) {
 		auto num_words_mod = calc_num_words_modifier(*x3.b);
 		auto num_syllable_mod = calc_syllable_modifier<m>(*x3, *x3.a);
@@ -1943,7 +2320,8 @@ auto Dict_Base::calc_syllable_modifier(Word_List::const_reference we) const
 {
 	auto subtract_syllable =
 	    m == AT_COMPOUND_END && !compound_syllable_vowels.empty() &&
-	    we.second.contains('I') && !we.second.contains('J');
+	    we.second->contains(flag_ids.find(u'I')) &&
+	    !we.second->contains(flag_ids.find(u'J'));
 	return 0 - subtract_syllable;
 }
 
@@ -1966,19 +2344,13 @@ auto Dict_Base::calc_syllable_modifier(Word_List::const_reference we,
 	num_syllable_mod -= sfx_extra;
 
 	if (compound_syllable_num) {
-		switch (sfx.flag) {
-		case 'c':
+		auto flag_j = flag_ids.find(u'J');
+		if (sfx.flag == flag_ids.find(u'c'))
 			num_syllable_mod += 2;
-			break;
-
-		case 'J':
+		else if (sfx.flag == flag_j)
 			num_syllable_mod += 1;
-			break;
-
-		case 'I':
-			num_syllable_mod += we.second.contains('J');
-			break;
-		}
+		else if (sfx.flag == flag_ids.find(u'I'))
+			num_syllable_mod += we.second->contains(flag_j);
 	}
 	return num_syllable_mod;
 }
@@ -1988,16 +2360,25 @@ auto Dict_Base::count_syllables(const std::wstring& word) const -> size_t
 	return count_appereances_of(word, compound_syllable_vowels);
 }
 
+/**
+ * @brief Checks compounding according to COMPOUNDRULE.
+ *
+ * @param rule_states stack of the states of compound_rules, the last one is
+ * the state after the parts before @p start_pos.
+ */
 auto Dict_Base::check_compound_with_rules(
-    std::wstring& word, std::vector<const Flag_Set*>& words_data,
-    size_t start_pos, std::wstring& part, Forceucase allow_bad_forceucase) const
+    std::wstring& word, std::vector<uint64_t>& rule_states, size_t start_pos,
+    std::wstring& part, Forceucase allow_bad_forceucase) const
     -> Compounding_Result
 {
+	auto state_size = compound_rules.state_size();
 	size_t min_length = 3;
 	if (compound_min_length != 0)
 		min_length = compound_min_length;
 	if (word.size() < min_length * 2)
 		return {};
+	if (!work_budget().spend())
+		return {};
 	size_t max_length = word.size() - min_length;
 	for (auto i = start_pos + min_length; i <= max_length; ++i) {
 
@@ -2005,7 +2386,7 @@ auto Dict_Base::check_compound_with_rules(
 		auto part1_entry = Word_List::const_pointer();
 		auto range = words.equal_range(part);
 		for (auto& we : make_iterator_range(range)) {
-			auto& word_flags = we.second;
+			auto& word_flags = *we.second;
 			if (word_flags.contains(need_affix_flag))
 				continue;
 			if (!compound_rules.has_any_of_flags(word_flags))
@@ -2015,14 +2396,21 @@ auto Dict_Base::check_compound_with_rules(
 		}
 		if (!part1_entry)
 			continue;
-		words_data.push_back(&part1_entry->second);
-		AT_SCOPE_EXIT(words_data.pop_back());
+
+		// no rule can match a compound beginning like this
+		auto depth = rule_states.size();
+		rule_states.resize(depth + state_size);
+		AT_SCOPE_EXIT(rule_states.resize(depth));
+		auto state1 = &rule_states[depth];
+		if (!compound_rules.advance(state1 - state_size,
+		                            *part1_entry->second, state1))
+			continue;
 
 		part.assign(word, i, word.npos);
 		auto part2_entry = Word_List::const_pointer();
 		range = words.equal_range(part);
 		for (auto& we : make_iterator_range(range)) {
-			auto& word_flags = we.second;
+			auto& word_flags = *we.second;
 			if (word_flags.contains(need_affix_flag))
 				continue;
 			if (!compound_rules.has_any_of_flags(word_flags))
@@ -2034,14 +2422,17 @@ auto Dict_Base::check_compound_with_rules(
 			goto try_recursive;
 
 		{
-			words_data.push_back(&part2_entry->second);
-			AT_SCOPE_EXIT(words_data.pop_back());
-
-			auto m = compound_rules.match_any_rule(words_data);
+			rule_states.resize(depth + 2 * state_size);
+			state1 = &rule_states[depth];
+			auto state2 = state1 + state_size;
+			auto m = compound_rules.advance(
+			             state1, *part2_entry->second, state2) &&
+			         compound_rules.is_accepting(state2);
+			rule_states.resize(depth + state_size);
 			if (!m)
 				goto try_recursive;
 			if (compound_force_uppercase && !allow_bad_forceucase &&
-			    part2_entry->second.contains(
+			    part2_entry->second->contains(
 			        compound_force_uppercase))
 				goto try_recursive;
 
@@ -2049,7 +2440,7 @@ auto Dict_Base::check_compound_with_rules(
 		}
 	try_recursive:
 		part2_entry = check_compound_with_rules(
-		    word, words_data, i, part, allow_bad_forceucase);
+		    word, rule_states, i, part, allow_bad_forceucase);
 		if (part2_entry)
 			return {part2_entry};
 	}
@@ -2084,13 +2475,13 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 			return;
 	}
 	auto backup = Short_WString(word);
-	auto casing = classify_casing(word);
+	auto casing = case_table.classify_casing(word);
 	auto hq_sugs = High_Quality_Sugs();
 	switch (casing) {
 	case Casing::SMALL:
 		if (compound_force_uppercase &&
 		    check_compound(word, ALLOW_BAD_FORCEUCASE)) {
-			to_title(word, icu_locale, word);
+			case_table.to_title(word, icu_locale, word);
 			out.push_back(word);
 			word = backup;
 			return;
@@ -2099,7 +2490,7 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 		break;
 	case Casing::INIT_CAPITAL:
 		hq_sugs |= suggest_low(word, out);
-		to_lower(word, icu_locale, word);
+		case_table.to_lower(word, icu_locale, word);
 		hq_sugs |= suggest_low(word, out);
 		break;
 	case Casing::CAMEL:
@@ -2108,7 +2499,8 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 		auto dot_idx = word.find('.');
 		if (dot_idx != word.npos) {
 			auto after_dot = wstring_view(word).substr(dot_idx + 1);
-			auto casing_after_dot = classify_casing(after_dot);
+			auto casing_after_dot =
+			    case_table.classify_casing(after_dot);
 			if (casing_after_dot == Casing::INIT_CAPITAL) {
 				word.insert(dot_idx + 1, 1, ' ');
 				insert_sug_first(word, out);
@@ -2116,17 +2508,17 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 			}
 		}
 		if (casing == Casing::PASCAL) {
-			to_lower_char_at(word, 0, icu_locale);
+			case_table.to_lower_char_at(word, 0, icu_locale);
 			if (spell_priv(word))
 				insert_sug_first(word, out);
 			hq_sugs |= suggest_low(word, out);
 		}
-		to_lower(backup, icu_locale, word);
+		case_table.to_lower(backup, icu_locale, word);
 		if (spell_priv(word))
 			insert_sug_first(word, out);
 		hq_sugs |= suggest_low(word, out);
 		if (casing == Casing::PASCAL) {
-			to_title(backup, icu_locale, word);
+			case_table.to_title(backup, icu_locale, word);
 			if (spell_priv(word))
 				insert_sug_first(word, out);
 			hq_sugs |= suggest_low(word, out);
@@ -2143,20 +2535,20 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 			if (sug.compare(i, len, backup, backup.size() - len) ==
 			    0)
 				continue;
-			to_title_char_at(sug, i, icu_locale);
+			case_table.to_title_char_at(sug, i, icu_locale);
 			rotate(begin(out), it, it + 1);
 		}
 		break;
 	}
 	case Casing::ALL_CAPITAL:
-		to_lower(backup, icu_locale, word);
+		case_table.to_lower(backup, icu_locale, word);
 		if (keepcase_flag != 0 && spell_priv(word))
 			insert_sug_first(word, out);
 		hq_sugs |= suggest_low(word, out);
-		to_title(backup, icu_locale, word);
+		case_table.to_title(backup, icu_locale, word);
 		hq_sugs |= suggest_low(word, out);
 		for (auto& sug : out)
-			to_upper(sug, icu_locale, sug);
+			case_table.to_upper(sug, icu_locale, sug);
 		break;
 	}
 
@@ -2164,12 +2556,12 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 		if (casing == Casing::SMALL)
 			word = backup;
 		else
-			to_lower(backup, icu_locale, word);
+			case_table.to_lower(backup, icu_locale, word);
 		auto old_size = out.size();
 		ngram_suggest(word, out);
 		if (casing == Casing::ALL_CAPITAL) {
 			for (auto i = old_size; i != out.size(); ++i)
-				to_upper(out[i], icu_locale, out[i]);
+				case_table.to_upper(out[i], icu_locale, out[i]);
 		}
 	}
 
@@ -2205,7 +2597,7 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 
 	if (casing == Casing::INIT_CAPITAL || casing == Casing::PASCAL) {
 		for (auto& sug : out)
-			to_title_char_at(sug, 0, icu_locale);
+			case_table.to_title_char_at(sug, 0, icu_locale);
 	}
 
 	// Suggest with dots can go here but nobody uses it so no point in
@@ -2218,10 +2610,10 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 				return true;
 			if (spell_priv(s))
 				return true;
-			to_lower(s, icu_locale, s);
+			case_table.to_lower(s, icu_locale, s);
 			if (spell_priv(s))
 				return true;
-			to_title(s, icu_locale, s);
+			case_table.to_title(s, icu_locale, s);
 			return spell_priv(s);
 		};
 		auto it = begin(out);
@@ -2290,7 +2682,7 @@ auto Dict_Base::uppercase_suggest(std::wstring& word, List_WStrings& out) const
     -> void
 {
 	auto backup = word;
-	to_upper(word, icu_locale, word);
+	case_table.to_upper(word, icu_locale, word);
 	add_sug_if_correct(word, out);
 	word = backup;
 }
@@ -2415,6 +2807,8 @@ auto Dict_Base::is_rep_similar(std::wstring& word) const -> bool
 auto Dict_Base::map_suggest(std::wstring& word, List_WStrings& out,
                             size_t i) const -> void
 {
+	if (!work_budget().spend())
+		return;
 	for (; i != word.size(); ++i) {
 		for (auto& e : similarities) {
 			auto j = e.chars.find(word[i]);
@@ -2508,7 +2902,7 @@ auto Dict_Base::keyboard_suggest(std::wstring& word, List_WStrings& out) const
 	auto& kb = keyboard_closeness;
 	for (size_t j = 0; j != word.size(); ++j) {
 		auto c = word[j];
-		auto upp_c = u_toupper(c);
+		auto upp_c = case_table.simple_upper(c);
 		if (upp_c != c) {
 			word[j] = upp_c;
 			add_sug_if_correct(word, out);
@@ -2655,11 +3049,11 @@ auto Dict_Base::phonetic_suggest(std::wstring& word, List_WStrings& out) const
 {
 	auto backup = Short_WString(word);
 	transform(begin(word), end(word), begin(word),
-	          [](auto c) { return u_toupper(c); });
+	          [&](auto c) { return case_table.simple_upper(c); });
 	auto changed = phonetic_table.replace(word);
 	if (changed) {
 		transform(begin(word), end(word), begin(word),
-		          [](auto c) { return u_tolower(c); });
+		          [&](auto c) { return case_table.simple_lower(c); });
 		add_sug_if_correct(word, out);
 	}
 	word = backup;
@@ -2819,21 +3213,27 @@ struct Word_And_Score {
 auto Dict_Base::ngram_suggest(std::wstring& word, List_WStrings& out) const
     -> void
 {
+	if (work_budget().exhausted())
+		return;
 	auto backup = Short_WString(word);
 	auto wrong_word = wstring_view(backup);
 	auto roots = vector<Word_Entry_And_Score>();
+	auto dict_word_buffer = wstring();
 	for (size_t bucket = 0; bucket != words.bucket_count(); ++bucket) {
 		for (auto& word_entry : words.bucket_data(bucket)) {
-			auto& [dict_word, flags] = word_entry;
+			auto& flags = *word_entry.second;
 			if (flags.contains(forbiddenword_flag) ||
 			    flags.contains(HIDDEN_HOMONYM_FLAG) ||
 			    flags.contains(nosuggest_flag) ||
 			    flags.contains(compound_onlyin_flag))
 				continue;
+			auto dict_word =
+			    word_entry.first.to_wide(dict_word_buffer);
 			auto score =
 			    left_common_substring_length(wrong_word, dict_word);
 			auto& lower_dict_word = word;
-			to_lower(dict_word, icu_locale, lower_dict_word);
+			case_table.to_lower(dict_word, icu_locale,
+			                    lower_dict_word);
 			score += ngram_similarity_longer_worse(3, wrong_word,
 			                                       lower_dict_word);
 			if (roots.size() != 100) {
@@ -2863,14 +3263,16 @@ auto Dict_Base::ngram_suggest(std::wstring& word, List_WStrings& out) const
 	auto expanded_cross_afx = vector<bool>();
 	auto guess_words = vector<Word_And_Score>();
 	for (auto& root : roots) {
+		if (!work_budget().spend())
+			break;
 		expand_root_word_for_ngram(*root.word_entry, wrong_word,
 		                           expanded_list, expanded_cross_afx);
 		for (auto& expanded_word : expanded_list) {
 			auto score = left_common_substring_length(
 			    wrong_word, expanded_word);
 			auto& lower_expanded_word = word;
-			to_lower(expanded_word, icu_locale,
-			         lower_expanded_word);
+			case_table.to_lower(expanded_word, icu_locale,
+			                    lower_expanded_word);
 			score += ngram_similarity_any_mismatch(
 			    wrong_word.size(), wrong_word, lower_expanded_word);
 			if (score < threshold)
@@ -2894,7 +3296,7 @@ auto Dict_Base::ngram_suggest(std::wstring& word, List_WStrings& out) const
 	auto lcs_state = vector<size_t>();
 	for (auto& [guess_word, score] : guess_words) {
 		auto& lower_guess_word = word;
-		to_lower(guess_word, icu_locale, lower_guess_word);
+		case_table.to_lower(guess_word, icu_locale, lower_guess_word);
 		auto lcs = longest_common_subsequence_length(
 		    wrong_word, lower_guess_word, lcs_state);
 
@@ -2963,9 +3365,11 @@ auto Dict_Base::expand_root_word_for_ngram(
 {
 	expanded_list.clear();
 	cross_affix.clear();
-	auto& [root, flags] = root_entry;
+	auto root_buffer = wstring();
+	auto root = root_entry.first.to_wide(root_buffer);
+	auto& flags = *root_entry.second;
 	if (!flags.contains(need_affix_flag)) {
-		expanded_list.push_back(root);
+		expanded_list.emplace_back(root);
 		cross_affix.push_back(false);
 	}
 	if (flags.empty())
@@ -3041,18 +3445,42 @@ auto Dict_Base::expand_root_word_for_ngram(
 	}
 }
 
+// The generic pipeline is reachable from outside of this file, e.g. from the
+// tests through the default template argument, so it must be emitted even
+// when the optimizer inlines every use of it here.
+template auto Dict_Base::spell_break<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& s, size_t depth) const -> bool;
+template auto Dict_Base::spell_casing<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& s) const -> const Flag_Set*;
+template auto Dict_Base::spell_casing_upper<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& s) const -> const Flag_Set*;
+template auto Dict_Base::spell_casing_title<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& s) const -> const Flag_Set*;
+template auto Dict_Base::spell_sharps<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& base, size_t pos, size_t n, size_t rep) const
+    -> const Flag_Set*;
+template auto Dict_Base::check_word<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& s, Forceucase allow_bad_forceucase,
+    Hidden_Homonym skip_hidden_homonym) const -> const Flag_Set*;
+template auto Dict_Base::check_simple_word<Dict_Base::GENERIC_SPELLING>(
+    std::wstring& s, Hidden_Homonym skip_hidden_homonym) const
+    -> const Flag_Set*;
+
 Dictionary::Dictionary(std::istream& aff, std::istream& dic)
     : external_locale_known_utf8(true)
 {
 	if (!parse_aff_dic(aff, dic))
 		throw Dictionary_Loading_Error("error parsing");
+	specialize_spelling();
 }
 
-auto Dictionary::external_to_internal_encoding(const string& in,
+auto Dictionary::external_to_internal_encoding(string_view in,
                                                wstring& wide_out) const -> bool
 {
 	if (external_locale_known_utf8)
 		return utf8_to_wide(in, wide_out);
+	else if (external_codec.decode(in, wide_out))
+		return true;
 	else
 		return to_wide(in, external_locale, wide_out);
 }
@@ -3062,11 +3490,27 @@ auto Dictionary::internal_to_external_encoding(const wstring& wide_in,
 {
 	if (external_locale_known_utf8)
 		wide_to_utf8(wide_in, out);
-	else
+	else if (!external_codec.encode(wide_in, out))
 		return to_narrow(wide_in, out, external_locale);
 	return true;
 }
 
+/**
+ * @brief Same as internal_to_external_encoding(), but appends to @p out.
+ */
+auto Dictionary::append_external_encoding(const wstring& wide_in,
+                                          string& out) const -> bool
+{
+	if (external_locale_known_utf8) {
+		append_wide_to_utf8(wide_in, out);
+		return true;
+	}
+	auto static thread_local narrow = string();
+	auto ok = internal_to_external_encoding(wide_in, narrow);
+	out += narrow;
+	return ok;
+}
+
 Dictionary::Dictionary() : external_locale_known_utf8(true) {}
 
 /**
@@ -3112,6 +3556,188 @@ auto Dictionary::load_from_path(const std::string& file_path_without_extension)
 	return load_from_aff_dic(aff_file, dic_file);
 }
 
+/**
+ * @brief Create a dictionary from a compiled dictionary file
+ *
+ * The file is produced by compile_from_path() or compile_aff_dic(). It is
+ * memory mapped, the words are used from it without copying and the word
+ * table is restored without hashing, so loading is much faster than parsing
+ * .aff and .dic.
+ *
+ * The file records the size, modification time and hash of the .aff and .dic
+ * it was compiled from. If these files were changed since, the compiled
+ * dictionary is stale and is rejected. If they do not exist any more, the
+ * compiled dictionary is used as it is.
+ *
+ * @param compiled_path path to the compiled dictionary
+ * @param file_path_without_extension if not empty, the dictionary must have
+ * been compiled from these files.
+ * @return Dictionary object
+ * @throws Dictionary_Loading_Error if the file is missing, corrupted, stale or
+ * was compiled by a different version of Nuspell. In the last two cases just
+ * compile it again, see load_from_path_cached().
+ */
+auto Dictionary::load_from_compiled(
+    const std::string& compiled_path,
+    const std::string& file_path_without_extension) -> Dictionary
+{
+	auto file = std::make_shared<Mapped_File>(compiled_path);
+	if (!file->is_open()) {
+		auto err = "Compiled dictionary " + compiled_path + " not found";
+		throw Dictionary_Loading_Error(err);
+	}
+	auto source = Dictionary_Source();
+	if (!read_compiled_source(file->data(), file->size(), source)) {
+		auto err = "Compiled dictionary " + compiled_path +
+		           " is corrupted or from another version";
+		throw Dictionary_Loading_Error(err);
+	}
+	if (!file_path_without_extension.empty() &&
+	    source.path != file_path_without_extension) {
+		auto err = "Compiled dictionary " + compiled_path +
+		           " was not compiled from " +
+		           file_path_without_extension;
+		throw Dictionary_Loading_Error(err);
+	}
+	if (!source.is_up_to_date()) {
+		auto err = "Compiled dictionary " + compiled_path +
+		           " is older than " + source.path;
+		throw Dictionary_Loading_Error(err);
+	}
+	auto d = Dictionary();
+	if (!d.parse_compiled(file->data(), file->size(), file)) {
+		auto err = "Compiled dictionary " + compiled_path +
+		           " is corrupted or from another version";
+		throw Dictionary_Loading_Error(err);
+	}
+	d.specialize_spelling();
+	return d;
+}
+
+/**
+ * @brief Create a dictionary from files through a compiled dictionary
+ *
+ * Loads the compiled dictionary if it was compiled from the given files and
+ * they did not change since. Otherwise compiles it again first.
+ *
+ * @param file_path_without_extension path *without* extensions (without .dic or
+ * .aff)
+ * @param compiled_path path of the compiled dictionary
+ * @return Dictionary object
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::load_from_path_cached(
+    const std::string& file_path_without_extension,
+    const std::string& compiled_path) -> Dictionary
+{
+	try {
+		return load_from_compiled(compiled_path,
+		                          file_path_without_extension);
+	}
+	catch (const Dictionary_Loading_Error&) {
+	}
+	compile_from_path(file_path_without_extension, compiled_path);
+	return load_from_compiled(compiled_path, file_path_without_extension);
+}
+
+auto Dictionary::compile_with_source(std::istream& aff, std::istream& dic,
+                                     const Dictionary_Source& source,
+                                     std::ostream& out) -> void
+{
+	auto aff_text = string(istreambuf_iterator<char>(aff), {});
+	auto aff_in = istringstream(aff_text);
+	auto d = Dictionary(aff_in, dic);
+	if (!d.write_compiled(aff_text, source, out))
+		throw Dictionary_Loading_Error("error writing");
+}
+
+/**
+ * @brief Compile a dictionary from opened files as iostreams
+ *
+ * The compiled dictionary does not know where the files are, so it is never
+ * considered stale, see load_from_compiled().
+ *
+ * @param aff The iostream of the .aff file
+ * @param dic The iostream of the .dic file
+ * @param out The binary iostream where the compiled dictionary is written
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::compile_aff_dic(std::istream& aff, std::istream& dic,
+                                 std::ostream& out) -> void
+{
+	auto aff_text = string(istreambuf_iterator<char>(aff), {});
+	auto dic_text = string(istreambuf_iterator<char>(dic), {});
+	auto source = Dictionary_Source();
+	source.read_contents(aff_text, dic_text);
+	auto aff_in = istringstream(aff_text);
+	auto dic_in = istringstream(move(dic_text));
+	compile_with_source(aff_in, dic_in, source, out);
+}
+
+/**
+ * @brief Compile a dictionary from files, see load_from_compiled()
+ *
+ * The file at @p compiled_path is replaced only once the new one is written
+ * completely and its checksum is verified, so concurrent loaders never see a
+ * partial file.
+ *
+ * @param file_path_without_extension path *without* extensions (without .dic or
+ * .aff)
+ * @param compiled_path path of the compiled dictionary to write
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::compile_from_path(
+    const std::string& file_path_without_extension,
+    const std::string& compiled_path) -> void
+{
+	auto path = file_path_without_extension;
+	path += ".aff";
+	std::ifstream aff_file(path);
+	if (aff_file.fail()) {
+		auto err = "Aff file " + path + " not found";
+		throw Dictionary_Loading_Error(err);
+	}
+	path.replace(path.size() - 3, 3, "dic");
+	std::ifstream dic_file(path);
+	if (dic_file.fail()) {
+		auto err = "Dic file " + path + " not found";
+		throw Dictionary_Loading_Error(err);
+	}
+	auto source = Dictionary_Source();
+	if (!source.read_files(file_path_without_extension)) {
+		auto err = "Can not read " + file_path_without_extension;
+		throw Dictionary_Loading_Error(err);
+	}
+	// Dictionaries loaded from the old file keep it mapped and other
+	// processes may be loading it right now, so it is never truncated.
+	// The new one is written next to it and renamed over it when complete.
+	auto temp_path = unique_temp_path(compiled_path);
+	std::ofstream out_file(temp_path, std::ios_base::binary);
+	if (out_file.fail()) {
+		auto err = "Can not write " + compiled_path;
+		throw Dictionary_Loading_Error(err);
+	}
+	try {
+		compile_with_source(aff_file, dic_file, source, out_file);
+		out_file.close();
+		auto written = Mapped_File(temp_path);
+		if (out_file.fail() || !written.is_open() ||
+		    !verify_compiled(written.data(), written.size()))
+			throw Dictionary_Loading_Error("Can not write " +
+			                               compiled_path);
+	}
+	catch (...) {
+		out_file.close();
+		std::remove(temp_path.c_str());
+		throw;
+	}
+	if (!replace_file(temp_path, compiled_path)) {
+		std::remove(temp_path.c_str());
+		auto err = "Can not write " + compiled_path;
+		throw Dictionary_Loading_Error(err);
+	}
+}
+
 /**
  * @brief Sets external (public API) encoding
  *
@@ -3133,6 +3759,10 @@ auto Dictionary::imbue(const locale& loc) -> void
 {
 	external_locale = loc;
 	external_locale_known_utf8 = is_locale_known_utf8(external_locale);
+	if (external_locale_known_utf8)
+		external_codec.clear();
+	else
+		external_codec.build(external_locale);
 }
 
 /**
@@ -3142,14 +3772,42 @@ auto Dictionary::imbue(const locale& loc) -> void
  */
 auto Dictionary::imbue_utf8() -> void { external_locale_known_utf8 = true; }
 
+/**
+ * @brief Limits the work done by each call to spell() and suggest()
+ *
+ * The steps are counted in the searches for compounds, sharp s variants and
+ * suggestions, whose time can grow very fast with the length of the word.
+ * When a call runs out of steps it stops searching and returns what it has
+ * found so far, i.e. spell() may reject a correct compound and suggest() may
+ * return fewer suggestions. Use last_call_truncated() to detect that.
+ *
+ * @param max_steps maximal number of steps per call, 0 means unlimited,
+ * which is the default.
+ */
+auto Dictionary::set_max_work_steps(size_t max_steps) -> void
+{
+	max_work_steps = max_steps;
+}
+
+/**
+ * @brief Tells if the last spell() or suggest() call on the calling thread ran
+ * out of work steps
+ * @return true if the answer of that call may be incomplete
+ */
+auto Dictionary::last_call_truncated() const -> bool
+{
+	return work_budget().was_truncated();
+}
+
 /**
  * @brief Checks if a given word is correct
- * @param word any word
+ * @param word any word, e.g. a slice of a larger buffer
  * @return true if correct, false otherwise
  */
-auto Dictionary::spell(const std::string& word) const -> bool
+auto Dictionary::spell(std::string_view word) const -> bool
 {
 	auto static thread_local wide_word = wstring();
+	auto budget_scope = Work_Budget_Scope(max_work_steps);
 	auto ok_enc = external_to_internal_encoding(word, wide_word);
 	if (unlikely(wide_word.size() > 180)) {
 		wide_word.resize(180);
@@ -3162,27 +3820,54 @@ auto Dictionary::spell(const std::string& word) const -> bool
 }
 
 /**
- * @brief Suggests correct words for a given incorrect word
- * @param[in] word incorrect word
- * @param[out] out this object will be populated with the suggestions
+ * @brief Checks if a given word is correct
+ * @param word any word
+ * @return true if correct, false otherwise
  */
-auto Dictionary::suggest(const std::string& word,
-                         std::vector<std::string>& out) const -> void
+auto Dictionary::spell(const std::string& word) const -> bool
+{
+	return spell(std::string_view(word));
+}
+
+/**
+ * @brief Checks if a given word is correct
+ * @param word any null-terminated word
+ * @return true if correct, false otherwise
+ */
+auto Dictionary::spell(const char* word) const -> bool
+{
+	return spell(std::string_view(word));
+}
+
+auto Dictionary::suggest_wide(std::string_view word) const
+    -> const List_WStrings&
 {
 	auto static thread_local wide_word = wstring();
 	auto static thread_local wide_list = List_WStrings();
 
+	wide_list.clear();
+	auto budget_scope = Work_Budget_Scope(max_work_steps);
 	auto ok_enc = external_to_internal_encoding(word, wide_word);
 	if (unlikely(wide_word.size() > 180)) {
 		wide_word.resize(180);
 		wide_word.shrink_to_fit();
-		return;
+		return wide_list;
 	}
 	if (unlikely(!ok_enc))
-		return;
-	wide_list.clear();
+		return wide_list;
 	suggest_priv(wide_word, wide_list);
+	return wide_list;
+}
 
+/**
+ * @brief Suggests correct words for a given incorrect word
+ * @param[in] word incorrect word
+ * @param[out] out this object will be populated with the suggestions
+ */
+auto Dictionary::suggest(std::string_view word,
+                         std::vector<std::string>& out) const -> void
+{
+	auto& wide_list = suggest_wide(word);
 	auto narrow_list = List_Strings(move(out));
 	narrow_list.clear();
 	for (auto& w : wide_list) {
@@ -3191,4 +3876,46 @@ auto Dictionary::suggest(const std::string& word,
 	}
 	out = narrow_list.extract_sequence();
 }
+
+/**
+ * @brief Suggests correct words for a given incorrect word
+ * @param[in] word incorrect word
+ * @param[out] out this object will be populated with the suggestions
+ */
+auto Dictionary::suggest(const std::string& word,
+                         std::vector<std::string>& out) const -> void
+{
+	suggest(std::string_view(word), out);
+}
+
+/**
+ * @brief Suggests correct words for a given incorrect word
+ * @param[in] word incorrect null-terminated word
+ * @param[out] out this object will be populated with the suggestions
+ */
+auto Dictionary::suggest(const char* word, std::vector<std::string>& out) const
+    -> void
+{
+	suggest(std::string_view(word), out);
+}
+
+/**
+ * @brief Suggests correct words for a given incorrect word
+ *
+ * Same as the other overload, but all suggestions are written to one buffer.
+ * When the buffer is reused, this needs no allocations once it has grown
+ * enough.
+ *
+ * @param[in] word incorrect word
+ * @param[out] out this object will be populated with the suggestions
+ */
+auto Dictionary::suggest(std::string_view word, Suggestion_Buffer& out) const
+    -> void
+{
+	out.clear();
+	for (auto& w : suggest_wide(word)) {
+		append_external_encoding(w, out.chars);
+		out.ends.push_back(out.chars.size());
+	}
+}
 } // namespace nuspell
@@ -31,13 +31,6 @@
 namespace nuspell {
 inline namespace v3 {
 
-enum Affixing_Mode {
-	FULL_WORD,
-	AT_COMPOUND_BEGIN,
-	AT_COMPOUND_END,
-	AT_COMPOUND_MIDDLE
-};
-
 struct Affixing_Result_Base {
 	Word_List::const_pointer root_word = {};
 
@@ -103,31 +96,59 @@ struct Dict_Base : public Aff_Data {
 		HAS_HIGH_QUALITY_SUGS = true
 	};
 
+	/**
+	 * @brief Dictionary-level traits the spelling pipeline is specialized
+	 * on.
+	 *
+	 * A pipeline instantiated with a combination of the first three bits
+	 * knows these traits at compile time. GENERIC_SPELLING is the pipeline
+	 * that reads them from the dictionary on every call. Only some
+	 * combinations are instantiated, the others use the generic pipeline.
+	 */
+	enum Spell_Traits : unsigned char {
+		COMPLEX_PREFIXES = 1 << 0,
+		COMPOUNDING = 1 << 1,
+		CHECKSHARPS = 1 << 2,
+		GENERIC_SPELLING = 1 << 3
+	};
+
+	unsigned char spell_traits = GENERIC_SPELLING;
+
+	auto specialize_spelling() -> void;
+
 	auto spell_priv(std::wstring& s) const -> bool;
+	template <unsigned char st = GENERIC_SPELLING>
 	auto spell_break(std::wstring& s, size_t depth = 0) const -> bool;
+	template <unsigned char st = GENERIC_SPELLING>
 	auto spell_casing(std::wstring& s) const -> const Flag_Set*;
+	template <unsigned char st = GENERIC_SPELLING>
 	auto spell_casing_upper(std::wstring& s) const -> const Flag_Set*;
+	template <unsigned char st = GENERIC_SPELLING>
 	auto spell_casing_title(std::wstring& s) const -> const Flag_Set*;
+	template <unsigned char st = GENERIC_SPELLING>
 	auto spell_sharps(std::wstring& base, size_t n_pos = 0, size_t n = 0,
 	                  size_t rep = 0) const -> const Flag_Set*;
 
+	template <unsigned char st = GENERIC_SPELLING>
 	auto check_word(std::wstring& s, Forceucase allow_bad_forceucase = {},
 	                Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> const Flag_Set*;
+	auto root_buffer(std::wstring_view word) const -> Root_Buffer<wchar_t>;
+	template <unsigned char st = GENERIC_SPELLING>
 	auto check_simple_word(std::wstring& word,
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> const Flag_Set*;
 
-	template <Affixing_Mode m>
-	auto affix_NOT_valid(const Prefix<wchar_t>& a) const;
-	template <Affixing_Mode m>
-	auto affix_NOT_valid(const Suffix<wchar_t>& a) const;
+	template <Affixing_Mode m, class AffixT>
+	auto affix_NOT_valid(const AffixT& a) const;
 	template <Affixing_Mode m, class AffixT>
 	auto outer_affix_NOT_valid(const AffixT& a) const;
 	template <class AffixT>
 	auto is_circumfix(const AffixT& a) const;
 	template <Affixing_Mode m>
 	auto is_valid_inside_compound(const Flag_Set& flags) const;
+	template <Affixing_Mode m, class AffixT>
+	auto is_valid_inside_compound(const AffixT& a) const;
 
 	/**
 	 * @brief strip_prefix_only
@@ -135,7 +156,7 @@ struct Dict_Base : public Aff_Data {
 	 * @return if found, root word + prefix
 	 */
 	template <Affixing_Mode m = FULL_WORD>
-	auto strip_prefix_only(std::wstring& s,
+	auto strip_prefix_only(Root_Buffer<wchar_t>& s,
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Prefix<wchar_t>>;
 
@@ -145,7 +166,7 @@ struct Dict_Base : public Aff_Data {
 	 * @return if found, root word + suffix
 	 */
 	template <Affixing_Mode m = FULL_WORD>
-	auto strip_suffix_only(std::wstring& s,
+	auto strip_suffix_only(Root_Buffer<wchar_t>& s,
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Suffix<wchar_t>>;
 
@@ -160,12 +181,13 @@ struct Dict_Base : public Aff_Data {
 	 */
 	template <Affixing_Mode m = FULL_WORD>
 	auto
-	strip_prefix_then_suffix(std::wstring& s,
+	strip_prefix_then_suffix(Root_Buffer<wchar_t>& s,
 	                         Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>;
 
 	template <Affixing_Mode m>
-	auto strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe, std::wstring& s,
+	auto strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
+	                          Root_Buffer<wchar_t>& s,
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>;
 
@@ -180,111 +202,127 @@ struct Dict_Base : public Aff_Data {
 	 */
 	template <Affixing_Mode m = FULL_WORD>
 	auto
-	strip_suffix_then_prefix(std::wstring& s,
+	strip_suffix_then_prefix(Root_Buffer<wchar_t>& s,
 	                         Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>>;
 
 	template <Affixing_Mode m>
-	auto strip_sfx_then_pfx_2(const Suffix<wchar_t>& se, std::wstring& s,
+	auto strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
+	                          Root_Buffer<wchar_t>& s,
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Prefix<wchar_t>, Suffix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_then_suffix_commutative(
-	    std::wstring& word, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& word,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_pfx_then_sfx_comm_2(const Prefix<wchar_t>& pe,
-	                               std::wstring& word,
+	                               Root_Buffer<wchar_t>& word,
 	                               Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto
-	strip_suffix_then_suffix(std::wstring& s,
+	strip_suffix_then_suffix(Root_Buffer<wchar_t>& s,
 	                         Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>;
 
 	template <Affixing_Mode m>
-	auto strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1, std::wstring& s,
+	auto strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
+	                          Root_Buffer<wchar_t>& s,
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Suffix<wchar_t>, Suffix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto
-	strip_prefix_then_prefix(std::wstring& s,
+	strip_prefix_then_prefix(Root_Buffer<wchar_t>& s,
 	                         Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>;
 
 	template <Affixing_Mode m>
-	auto strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1, std::wstring& s,
+	auto strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
+	                          Root_Buffer<wchar_t>& s,
 	                          Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<Prefix<wchar_t>, Prefix<wchar_t>>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_then_2_suffixes(
-	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& s,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m>
 	auto strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
-	                       const Suffix<wchar_t>& se1, std::wstring& s,
+	                       const Suffix<wchar_t>& se1,
+	                       Root_Buffer<wchar_t>& s,
 	                       Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_suffix_prefix_suffix(
-	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& s,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m>
 	auto strip_s_p_s_3(const Suffix<wchar_t>& se1,
-	                   const Prefix<wchar_t>& pe1, std::wstring& word,
+	                   const Prefix<wchar_t>& pe1,
+	                   Root_Buffer<wchar_t>& word,
 	                   Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_2_suffixes_then_prefix(
-	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& s,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m>
 	auto strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
-	                       const Suffix<wchar_t>& se2, std::wstring& word,
+	                       const Suffix<wchar_t>& se2,
+	                       Root_Buffer<wchar_t>& word,
 	                       Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_suffix_then_2_prefixes(
-	    std::wstring& s, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& s,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m>
 	auto strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
-	                       const Prefix<wchar_t>& pe1, std::wstring& s,
+	                       const Prefix<wchar_t>& pe1,
+	                       Root_Buffer<wchar_t>& s,
 	                       Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_suffix_prefix(
-	    std::wstring& word, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& word,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m>
 	auto strip_p_s_p_3(const Prefix<wchar_t>& pe1,
-	                   const Suffix<wchar_t>& se1, std::wstring& word,
+	                   const Suffix<wchar_t>& se1,
+	                   Root_Buffer<wchar_t>& word,
 	                   Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_2_prefixes_then_suffix(
-	    std::wstring& word, Hidden_Homonym skip_hidden_homonym = {}) const
+	    Root_Buffer<wchar_t>& word,
+	    Hidden_Homonym skip_hidden_homonym = {}) const
 	    -> Affixing_Result<>;
 
 	template <Affixing_Mode m>
 	auto strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
-	                       const Prefix<wchar_t>& pe2, std::wstring& word,
+	                       const Prefix<wchar_t>& pe2,
+	                       Root_Buffer<wchar_t>& word,
 	                       Hidden_Homonym skip_hidden_homonym) const
 	    -> Affixing_Result<>;
 
@@ -330,10 +368,9 @@ struct Dict_Base : public Aff_Data {
 	auto count_syllables(const std::wstring& word) const -> size_t;
 
 	auto check_compound_with_rules(std::wstring& word,
-	                               std::vector<const Flag_Set*>& words_data,
+	                               std::vector<uint64_t>& rule_states,
 	                               size_t start_pos, std::wstring& part,
 	                               Forceucase allow_bad_forceucase) const
-
 	    -> Compounding_Result;
 
 	auto suggest_priv(std::wstring& word, List_WStrings& out) const -> void;
@@ -411,20 +448,73 @@ class Dictionary_Loading_Error : public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+/**
+ * @brief Suggestions stored one after another in a single buffer of characters
+ *
+ * Reusing one buffer for many calls to Dictionary::suggest() avoids allocating
+ * a string for each suggestion.
+ */
+class Suggestion_Buffer {
+	std::string chars;
+	std::vector<size_t> ends;
+
+	friend class Dictionary;
+
+      public:
+	auto size() const noexcept { return ends.size(); }
+	auto empty() const noexcept { return ends.empty(); }
+	auto operator[](size_t i) const -> std::string_view
+	{
+		auto first = i == 0 ? size_t(0) : ends[i - 1];
+		return std::string_view(chars).substr(first, ends[i] - first);
+	}
+	auto clear() noexcept -> void
+	{
+		chars.clear();
+		ends.clear();
+	}
+	auto push_back(std::string_view word) -> void
+	{
+		chars += word;
+		ends.push_back(chars.size());
+	}
+
+	/**
+	 * @brief All suggestions concatenated.
+	 */
+	auto data() const noexcept -> std::string_view { return chars; }
+
+	/**
+	 * @brief Offsets in data() where the suggestions end.
+	 */
+	auto end_offsets() const noexcept -> const std::vector<size_t>&
+	{
+		return ends;
+	}
+};
+
 /**
  * @brief The only important public class
  */
 class Dictionary : private Dict_Base {
 	std::locale external_locale;
 	bool external_locale_known_utf8;
+	Single_Byte_Codec external_codec;
+	size_t max_work_steps = 0;
 
 	Dictionary(std::istream& aff, std::istream& dic);
-	auto external_to_internal_encoding(const std::string& in,
+	auto external_to_internal_encoding(std::string_view in,
 	                                   std::wstring& wide_out) const
 	    -> bool;
 
 	auto internal_to_external_encoding(const std::wstring& wide_in,
 	                                   std::string& out) const -> bool;
+	auto append_external_encoding(const std::wstring& wide_in,
+	                              std::string& out) const -> bool;
+	auto suggest_wide(std::string_view word) const -> const List_WStrings&;
+	auto static compile_with_source(std::istream& aff, std::istream& dic,
+	                                const Dictionary_Source& source,
+	                                std::ostream& out) -> void;
 
       public:
 	Dictionary();
@@ -432,11 +522,32 @@ class Dictionary : private Dict_Base {
 	    -> Dictionary;
 	auto static load_from_path(
 	    const std::string& file_path_without_extension) -> Dictionary;
+	auto static load_from_compiled(
+	    const std::string& compiled_path,
+	    const std::string& file_path_without_extension = {}) -> Dictionary;
+	auto static load_from_path_cached(
+	    const std::string& file_path_without_extension,
+	    const std::string& compiled_path) -> Dictionary;
+	auto static compile_aff_dic(std::istream& aff, std::istream& dic,
+	                            std::ostream& out) -> void;
+	auto static compile_from_path(
+	    const std::string& file_path_without_extension,
+	    const std::string& compiled_path) -> void;
 	auto imbue(const std::locale& loc) -> void;
 	auto imbue_utf8() -> void;
+	auto set_max_work_steps(size_t max_steps) -> void;
+	auto last_call_truncated() const -> bool;
+	auto spell(std::string_view word) const -> bool;
 	auto spell(const std::string& word) const -> bool;
+	auto spell(const char* word) const -> bool;
+	auto suggest(std::string_view word, std::vector<std::string>& out) const
+	    -> void;
 	auto suggest(const std::string& word,
 	             std::vector<std::string>& out) const -> void;
+	auto suggest(const char* word, std::vector<std::string>& out) const
+	    -> void;
+	auto suggest(std::string_view word, Suggestion_Buffer& out) const
+	    -> void;
 };
 } // namespace v3
 } // namespace nuspell
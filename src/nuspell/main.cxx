@@ -53,6 +53,7 @@ enum Mode {
 	LINES_MODE, /**< intermediate mode used while parsing command line
 	               arguments, otherwise unused */
 	LIST_DICTIONARIES_MODE /**< printing available dictionaries */,
+	COMPILE_MODE /**< writing compiled dictionary */,
 	HELP_MODE /**< printing help information */,
 	VERSION_MODE /**< printing version information */,
 	ERROR_MODE
@@ -63,6 +64,8 @@ struct Args_t {
 	bool unicode_segmentation = false;
 	string program_name = "nuspell";
 	string dictionary;
+	string compiled_dictionary;
+	string compile_output;
 	string encoding;
 	vector<string> other_dicts;
 	vector<string> files;
@@ -88,7 +91,7 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 	int c;
 	// The program can run in various modes depending on the
 	// command line options. mode is FSM state, this while loop is FSM.
-	const char* shortopts = ":d:i:aDGLSlhv";
+	const char* shortopts = ":d:i:c:C:aDGLSlhv";
 	const struct option longopts[] = {
 	    {"version", 0, nullptr, 'v'},
 	    {"help", 0, nullptr, 'h'},
@@ -115,6 +118,18 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 		case 'i':
 			encoding = optarg;
 
+			break;
+		case 'c':
+			if (mode == DEFAULT_MODE)
+				mode = COMPILE_MODE;
+			else
+				mode = ERROR_MODE;
+			compile_output = optarg;
+
+			break;
+		case 'C':
+			compiled_dictionary = optarg;
+
 			break;
 		case 'D':
 			if (mode == DEFAULT_MODE)
@@ -267,6 +282,7 @@ auto print_help(const string& program_name) -> void
 	     "\n";
 	o << p << " [-S] [-d dict_NAME] [-i enc] [file_name]...\n";
 	o << p << " -l|-G [-L] [-S] [-d dict_NAME] [-i enc] [file_name]...\n";
+	o << p << " -c FILE [-d dict_NAME]\n";
 	o << p << " -D|-h|--help|-v|--version\n";
 	o << "\n"
 	     "Check spelling of each FILE. Without FILE, check standard "
@@ -274,6 +290,9 @@ auto print_help(const string& program_name) -> void
 	     "\n"
 	     "  -d di_CT      use di_CT dictionary. Only one dictionary at a\n"
 	     "                time is currently supported\n"
+	     "  -c FILE       compile the dictionary into FILE and exit\n"
+	     "  -C FILE       use compiled dictionary FILE, see -c. It is\n"
+	     "                compiled again if the dictionary changed\n"
 	     "  -D            print search paths and available dictionaries\n"
 	     "                and exit\n"
 	     "  -i enc        input/output encoding, default is active locale\n"
@@ -285,6 +304,8 @@ auto print_help(const string& program_name) -> void
 	     "  -v, --version print version number and exit\n"
 	     "\n";
 	o << "Example: " << p << " -d en_US file.txt\n";
+	o << "         " << p << " -d en_US -c en_US.ndc\n";
+	o << "         " << p << " -C en_US.ndc file.txt\n";
 	o << "\n"
 	     "Bug reports: <https://github.com/nuspell/nuspell/issues>\n"
 	     "Full documentation: "
@@ -577,7 +598,20 @@ int main(int argc, char* argv[])
 	clog << "INFO: Pointed dictionary " << filename << ".{dic,aff}\n";
 	auto dic = My_Dictionary();
 	try {
-		dic = Dictionary::load_from_path(filename);
+		if (args.mode == COMPILE_MODE) {
+			Dictionary::compile_from_path(filename,
+			                              args.compile_output);
+			return 0;
+		}
+		if (args.compiled_dictionary.empty()) {
+			dic = Dictionary::load_from_path(filename);
+		}
+		else {
+			clog << "INFO: Pointed compiled dictionary "
+			     << args.compiled_dictionary << '\n';
+			dic = Dictionary::load_from_path_cached(
+			    filename, args.compiled_dictionary);
+		}
 		dic.parse_personal_dict(args.dictionary, loc);
 	}
 	catch (const Dictionary_Loading_Error& e) {
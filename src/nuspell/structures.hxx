@@ -25,19 +25,31 @@
 #define NUSPELL_STRUCTURES_HXX
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <iterator>
+#include <memory>
 #include <stack>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-#include <boost/container/small_vector.hpp>
 #include <boost/range/iterator_range_core.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define NUSPELL_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace nuspell {
 inline namespace v3 {
 #define NUSPELL_LITERAL(T, x) ::nuspell::literal_choose<T>(x, L##x)
@@ -64,6 +76,7 @@ template <class CharT>
 class String_Set {
       private:
 	std::basic_string<CharT> d;
+	std::array<uint64_t, 4> low_bits = {}; // elements below 256
 	auto sort_uniq() -> void
 	{
 		auto first = begin();
@@ -71,6 +84,20 @@ class String_Set {
 		using t = traits_type;
 		sort(first, last, t::lt);
 		d.erase(unique(first, last, t::eq), last);
+		update_low_bits();
+	}
+	static auto to_unsigned(CharT c)
+	{
+		return static_cast<std::make_unsigned_t<CharT>>(c);
+	}
+	auto update_low_bits() -> void
+	{
+		low_bits = {};
+		for (auto c : d) {
+			auto u = to_unsigned(c);
+			if (u < 256)
+				low_bits[u / 64] |= uint64_t(1) << (u % 64);
+		}
 	}
 	struct Char_Traits_Less_Than {
 		auto operator()(CharT a, CharT b) const noexcept
@@ -171,6 +198,7 @@ class String_Set {
 			return {it, false};
 		}
 		auto ret = d.insert(it, x);
+		update_low_bits();
 		return {ret, true};
 	}
 	iterator insert(iterator hint, value_type x)
@@ -178,7 +206,9 @@ class String_Set {
 		if (hint == end() || traits_type::lt(x, *hint)) {
 			if (hint == begin() ||
 			    traits_type::lt(*(hint - 1), x)) {
-				return d.insert(hint, x);
+				auto ret = d.insert(hint, x);
+				update_low_bits();
+				return ret;
 			}
 		}
 		return insert(x).first;
@@ -208,22 +238,38 @@ class String_Set {
 		return insert(hint, CharT(args...));
 	}
 
-	iterator erase(iterator position) { return d.erase(position); }
+	iterator erase(iterator position)
+	{
+		auto ret = d.erase(position);
+		update_low_bits();
+		return ret;
+	}
 	size_type erase(key_type x)
 	{
 		auto i = d.find(x);
 		if (i != d.npos) {
 			d.erase(i, 1);
+			update_low_bits();
 			return true;
 		}
 		return false;
 	}
 	iterator erase(iterator first, iterator last)
 	{
-		return d.erase(first, last);
+		auto ret = d.erase(first, last);
+		update_low_bits();
+		return ret;
+	}
+	void swap(String_Set& s)
+	{
+		d.swap(s.d);
+		low_bits.swap(s.low_bits);
+	}
+	void clear() noexcept
+	{
+		d.clear();
+		low_bits = {};
 	}
-	void swap(String_Set& s) { d.swap(s.d); }
-	void clear() noexcept { d.clear(); }
 
 	// non standrd modifiers:
 	auto insert(const Str& s) -> void
@@ -285,7 +331,13 @@ class String_Set {
 	}
 
 	// non standard set operations:
-	bool contains(key_type x) const { return count(x); }
+	bool contains(key_type x) const
+	{
+		auto u = to_unsigned(x);
+		if (u < 256)
+			return (low_bits[u / 64] >> (u % 64)) & 1;
+		return count(x);
+	}
 
 	// compare
 	bool operator<(const String_Set& rhs) const { return d < rhs.d; }
@@ -509,27 +561,215 @@ struct identity {
 	}
 };
 
-template <class Value, class Key = Value, class KeyExtract = identity>
+namespace detail {
+/**
+ * @brief Index of the lowest set bit, @p x must not be zero.
+ */
+inline auto count_trailing_zeros(uint32_t x) -> unsigned
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctz(x);
+#elif defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, x);
+	return idx;
+#else
+	unsigned n = 0;
+	for (; !(x & 1); x >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+/**
+ * @brief Bitmask of the bytes in a group of 16 control bytes equal to @p b.
+ */
+inline auto match_ctrl_group(const unsigned char* group, unsigned char b)
+    -> uint32_t
+{
+#ifdef NUSPELL_HAS_SSE2
+	auto g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+	auto eq = _mm_cmpeq_epi8(g, _mm_set1_epi8(static_cast<char>(b)));
+	return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#else
+	auto ret = uint32_t(0);
+	for (unsigned i = 0; i != 16; ++i)
+		ret |= uint32_t(group[i] == b) << i;
+	return ret;
+#endif
+}
+} // namespace detail
+
+/**
+ * @brief Polynomial string hash, h(s) = s[0]*B^(n-1) + ... + s[n-1] mod 2^64.
+ *
+ * When one end of a string is replaced, the hash of the new string can be
+ * derived from the hash of the old one in time proportional to the lengths of
+ * the replaced parts, see replace_prefix() and replace_suffix().
+ */
+template <class CharT>
+struct Polynomial_Hash {
+	using Str_View = std::basic_string_view<CharT>;
+	static constexpr uint64_t base = 0x9e3779b97f4a7c15ull;
+
+	static constexpr auto inverse_of_base() -> uint64_t
+	{
+		// Newton's iteration, each step doubles the correct low bits
+		auto x = base;
+		for (int i = 0; i != 5; ++i)
+			x *= 2 - base * x;
+		return x;
+	}
+	static constexpr uint64_t inverse_base = inverse_of_base();
+	static_assert(base * inverse_base == 1);
+
+	static auto power(uint64_t b, size_t n) -> uint64_t
+	{
+		auto ret = uint64_t(1);
+		for (; n; n >>= 1, b *= b)
+			if (n & 1)
+				ret *= b;
+		return ret;
+	}
+	static auto append(uint64_t h, Str_View s) -> uint64_t
+	{
+		for (auto c : s)
+			h = h * base + std::make_unsigned_t<CharT>(c);
+		return h;
+	}
+	static auto hash(Str_View s) -> uint64_t { return append(0, s); }
+	auto operator()(Str_View s) const -> size_t { return hash(s); }
+
+	/**
+	 * @brief Hash of the string with hash @p h after replacing its suffix
+	 * @p old_suffix with @p new_suffix.
+	 */
+	static auto replace_suffix(uint64_t h, Str_View old_suffix,
+	                           Str_View new_suffix) -> uint64_t
+	{
+		h -= hash(old_suffix);
+		h *= power(inverse_base, old_suffix.size());
+		return append(h, new_suffix);
+	}
+	/**
+	 * @brief Hash of the string with hash @p h after replacing its prefix
+	 * @p old_prefix with @p new_prefix.
+	 * @param rest_size the size of the string without the prefix.
+	 */
+	static auto replace_prefix(uint64_t h, Str_View old_prefix,
+	                           Str_View new_prefix, size_t rest_size)
+	    -> uint64_t
+	{
+		auto p = power(base, rest_size);
+		h -= hash(old_prefix) * p;
+		return h + hash(new_prefix) * p;
+	}
+};
+
+/**
+ * @brief Multiset backed by a flat open-addressing hash table.
+ *
+ * Elements are stored contiguously in one array of slots. A parallel array of
+ * control bytes holds 7 bits of the hash of each occupied slot and is probed
+ * linearly, 16 bytes at a time. Probe sequences never wrap around, and
+ * elements with equal keys are always kept in adjacent slots, so
+ * equal_range() returns a contiguous range.
+ *
+ * The hash values of @p Hash are mixed before use, so it does not need to
+ * spread the bits well, see Polynomial_Hash.
+ */
+template <class Value, class Key = Value, class KeyExtract = identity,
+          class Hash = std::hash<Key>>
 class Hash_Multiset {
       private:
-	using bucket_type = boost::container::small_vector<Value, 1>;
 	static constexpr float max_load_fact = 7.0 / 8.0;
-	std::vector<bucket_type> data;
+	static constexpr size_t group_size = 16;
+	static constexpr unsigned char empty_ctrl = 0x80;
+
+	std::vector<Value> data;
+	std::vector<unsigned char> ctrl; // data.size() + group_size bytes
 	size_t sz = 0;
 	size_t max_load_factor_capacity = 0;
+	size_t home_mask = 0;
+
+	static auto mix(size_t h) -> uint64_t
+	{
+		auto m = uint64_t(h);
+		m ^= m >> 33;
+		m *= 0xff51afd7ed558ccdull;
+		m ^= m >> 33;
+		return m;
+	}
+	static auto ctrl_of(uint64_t m) -> unsigned char
+	{
+		return static_cast<unsigned char>(m >> 57);
+	}
+
+	/**
+	 * @brief Finds the first slot holding @p key or the first empty slot.
+	 * @return pair of index and whether the key was found.
+	 */
+	template <class K>
+	auto find_slot(const K& key, uint64_t m) const
+	    -> std::pair<size_t, bool>
+	{
+		auto key_extract = KeyExtract();
+		auto c = ctrl_of(m);
+		auto pos = size_t(m & home_mask);
+		for (;; pos += group_size) {
+			auto group = &ctrl[pos];
+			auto matches = detail::match_ctrl_group(group, c);
+			auto empties = detail::match_ctrl_group(group, empty_ctrl);
+			if (empties)
+				matches &= (empties & -empties) - 1;
+			for (; matches; matches &= matches - 1) {
+				auto i = pos + detail::count_trailing_zeros(matches);
+				if (key == key_extract(data[i]))
+					return {i, true};
+			}
+			if (empties)
+				return {pos + detail::count_trailing_zeros(empties),
+				        false};
+		}
+	}
+	auto find_empty(size_t pos) const
+	{
+		for (;; pos += group_size) {
+			auto e = detail::match_ctrl_group(&ctrl[pos], empty_ctrl);
+			if (e)
+				return pos + detail::count_trailing_zeros(e);
+		}
+	}
+	template <class K>
+	auto run_end(const K& key, size_t i) const
+	{
+		auto key_extract = KeyExtract();
+		while (i != data.size() && ctrl[i] != empty_ctrl &&
+		       key == key_extract(data[i]))
+			++i;
+		return i;
+	}
+	auto grow_tail(size_t min_size) -> void
+	{
+		auto n = data.size();
+		while (n <= min_size)
+			n += group_size;
+		data.resize(n);
+		ctrl.resize(n + group_size, empty_ctrl);
+	}
 
       public:
 	using key_type = Key;
 	using value_type = Value;
 	using size_type = std::size_t;
 	using difference_type = std::ptrdiff_t;
-	using hasher = std::hash<Key>;
+	using hasher = Hash;
 	using reference = value_type&;
 	using const_reference = const value_type&;
-	using pointer = typename bucket_type::pointer;
-	using const_pointer = typename bucket_type::const_pointer;
-	using local_iterator = typename bucket_type::iterator;
-	using local_const_iterator = typename bucket_type::const_iterator;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+	using local_iterator = pointer;
+	using local_const_iterator = const_pointer;
 
 	Hash_Multiset() = default;
 
@@ -542,7 +782,9 @@ class Hash_Multiset {
 			size_t capacity = 16;
 			while (capacity <= count)
 				capacity <<= 1;
-			data.resize(capacity);
+			data.assign(capacity + group_size, value_type());
+			ctrl.assign(capacity + 2 * group_size, empty_ctrl);
+			home_mask = capacity - 1;
 			max_load_factor_capacity =
 			    std::ceil(capacity * max_load_fact);
 			return;
@@ -551,14 +793,15 @@ class Hash_Multiset {
 			count = size() / max_load_fact;
 		auto n = Hash_Multiset();
 		n.rehash(count);
-		for (auto& b : data) {
-			for (auto& x : b) {
-				n.insert(x);
-			}
+		for (size_t i = 0; i != data.size(); ++i) {
+			if (ctrl[i] != empty_ctrl)
+				n.insert(std::move(data[i]));
 		}
 		data.swap(n.data);
+		ctrl.swap(n.ctrl);
 		sz = n.sz;
 		max_load_factor_capacity = n.max_load_factor_capacity;
+		home_mask = n.home_mask;
 	}
 
 	auto reserve(size_t count) -> void
@@ -566,7 +809,7 @@ class Hash_Multiset {
 		rehash(std::ceil(count / max_load_fact));
 	}
 
-	auto insert(const_reference value)
+	auto insert(value_type value) -> local_iterator
 	{
 		using namespace std;
 		auto hash = hasher();
@@ -575,28 +818,26 @@ class Hash_Multiset {
 			reserve(sz + 1);
 		}
 		auto&& key = key_extract(value);
-		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		if (bucket.size() == 0 || bucket.size() == 1 ||
-		    key == key_extract(bucket.back())) {
-			bucket.push_back(value);
-			++sz;
-			return end(bucket) - 1;
-		}
-		auto last =
-		    std::find_if(rbegin(bucket), rend(bucket), [&](auto& x) {
-			    return key == key_extract(x);
-		    });
-		if (last != rend(bucket)) {
-			auto ret = bucket.insert(last.base(), value);
-			++sz;
-			return ret;
-		}
-
-		bucket.push_back(value);
+		auto m = mix(hash(key));
+		auto [i, found] = find_slot(key, m);
+		if (found) {
+			// Keep equal keys adjacent. Place the new element after
+			// the last equal one and shift the rest of the cluster.
+			i = run_end(key, i);
+			auto e = find_empty(i);
+			if (e >= data.size())
+				grow_tail(e);
+			auto d = data.data();
+			move_backward(d + i, d + e, d + e + 1);
+			copy_backward(&ctrl[i], &ctrl[e], &ctrl[e + 1]);
+		}
+		else if (i >= data.size()) {
+			grow_tail(i);
+		}
+		ctrl[i] = ctrl_of(m);
+		data[i] = std::move(value);
 		++sz;
-		return end(bucket) - 1;
+		return &data[i];
 	}
 	template <class... Args>
 	auto emplace(Args&&... a)
@@ -604,44 +845,257 @@ class Hash_Multiset {
 		return insert(value_type(std::forward<Args>(a)...));
 	}
 
-	auto equal_range(const key_type& key) const
+	/**
+	 * @brief Finds the elements with keys equal to @p key.
+	 *
+	 * @p key can be of any type that is comparable with key_type and that
+	 * hasher accepts, giving the same hash as for the equal key_type.
+	 */
+	template <class K>
+	auto equal_range(const K& key) const
+	    -> std::pair<local_const_iterator, local_const_iterator>
+	{
+		return equal_range(key, hasher()(key));
+	}
+	/**
+	 * @brief Same as equal_range(key), with @p hash equal to
+	 * hasher()(key) already computed by the caller.
+	 */
+	template <class K>
+	auto equal_range(const K& key, size_t hash) const
 	    -> std::pair<local_const_iterator, local_const_iterator>
 	{
-		using namespace std;
-		auto hash = hasher();
-		auto key_extract = KeyExtract();
 		if (data.empty())
 			return {};
-		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		if (bucket.empty())
+		auto [i, found] = find_slot(key, mix(hash));
+		if (!found)
 			return {};
-		if (bucket.size() == 1) {
-			if (key == key_extract(bucket.front()))
-				return {begin(bucket), end(bucket)};
-			return {};
-		}
-		auto first =
-		    std::find_if(begin(bucket), end(bucket), [&](auto& x) {
-			    return key == key_extract(x);
-		    });
-		if (first == end(bucket))
-			return {};
-		auto next = first + 1;
-		if (next == end(bucket) || key != key_extract(*next))
-			return {first, next};
-		auto last =
-		    std::find_if(rbegin(bucket), rend(bucket), [&](auto& x) {
-			    return key == key_extract(x);
-		    });
-		return {first, last.base()};
+		return {&data[i], data.data() + run_end(key, i + 1)};
 	}
 
 	auto bucket_count() const -> size_type { return data.size(); }
 	auto bucket_data(size_type i) const
 	{
-		return boost::make_iterator_range(data[i]);
+		auto first = &data[i];
+		return boost::make_iterator_range(
+		    first, first + (ctrl[i] != empty_ctrl));
+	}
+
+	/**
+	 * @brief Number of slots where probing can start, a power of two.
+	 */
+	auto home_capacity() const -> size_type { return home_mask + 1; }
+	/**
+	 * @brief Control bytes of the slots, bucket_count() + 16 of them.
+	 */
+	auto controls() const -> const unsigned char* { return ctrl.data(); }
+
+	/**
+	 * @brief Restores the layout of another table without hashing.
+	 *
+	 * The other table must have used the same hasher. Its elements are
+	 * given in the order of its slots, which is the order of iterating
+	 * over bucket_data() of all buckets.
+	 *
+	 * @param capacity home_capacity() of the other table.
+	 * @param controls controls() of the other table.
+	 * @param slots bucket_count() of the other table.
+	 * @param first iterator to the elements.
+	 * @param count number of elements.
+	 * @return false if the layout is not valid, the table is then empty.
+	 */
+	template <class InputIt>
+	auto restore(size_t capacity, const unsigned char* controls,
+	             size_t slots, InputIt first, size_t count) -> bool
+	{
+		*this = Hash_Multiset();
+		if (capacity < 16 || (capacity & (capacity - 1)) ||
+		    slots < capacity + group_size)
+			return false;
+		auto used = size_t(0);
+		for (size_t i = 0; i != slots; ++i)
+			used += controls[i] != empty_ctrl;
+		auto tail = controls + slots;
+		if (used != count ||
+		    std::any_of(tail, tail + group_size,
+		                [](auto c) { return c != empty_ctrl; }))
+			return false;
+		ctrl.assign(controls, tail + group_size);
+		data.resize(slots);
+		for (size_t i = 0; i != slots; ++i)
+			if (ctrl[i] != empty_ctrl)
+				data[i] = *first++;
+		sz = count;
+		home_mask = capacity - 1;
+		max_load_factor_capacity = std::ceil(capacity * max_load_fact);
+		return true;
+	}
+};
+
+/**
+ * @brief Split block Bloom filter over hash values.
+ *
+ * Every value sets one bit in each of the eight 32-bit words of a single
+ * 32-byte block, so a query reads only one cache line. With 16 bits per value
+ * the false positive rate is about 0.5%.
+ */
+class Bloom_Filter {
+	struct alignas(32) Block {
+		uint32_t words[8];
+	};
+	static constexpr size_t bits_per_value = 16;
+
+	std::vector<Block> blocks;
+	size_t cap = 0;
+
+	static auto mix(size_t h) -> uint64_t
+	{
+		auto m = uint64_t(h);
+		m ^= m >> 33;
+		m *= 0xff51afd7ed558ccdull;
+		m ^= m >> 33;
+		return m;
+	}
+	auto block_of(uint64_t m) const -> size_t
+	{
+		return ((m >> 32) * blocks.size()) >> 32;
+	}
+	static auto bit_of(uint64_t m, unsigned i) -> uint32_t
+	{
+		constexpr uint32_t salts[8] = {
+		    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+		    0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31};
+		return uint32_t(1) << ((uint32_t(m) * salts[i]) >> 27);
+	}
+
+      public:
+	/**
+	 * @brief Empties the filter and sizes it for @p capacity values.
+	 */
+	auto reset(size_t capacity) -> void
+	{
+		auto n = (capacity * bits_per_value + 255) / 256;
+		blocks.assign(std::max(n, size_t(1)), Block());
+		cap = capacity;
+	}
+	auto capacity() const { return cap; }
+	auto block_count() const { return blocks.size(); }
+	/**
+	 * @brief The bits of the filter, 8 words per block.
+	 */
+	auto words() const -> const uint32_t*
+	{
+		return reinterpret_cast<const uint32_t*>(blocks.data());
+	}
+	/**
+	 * @brief Restores a filter from capacity() and words() of another.
+	 */
+	auto restore(size_t capacity, const uint32_t* words, size_t n_blocks)
+	    -> void
+	{
+		blocks.resize(n_blocks);
+		for (size_t i = 0; i != n_blocks; ++i)
+			std::copy_n(words + i * 8, 8, blocks[i].words);
+		cap = capacity;
+	}
+	auto insert(size_t hash) -> void
+	{
+		auto m = mix(hash);
+		auto& b = blocks[block_of(m)];
+		for (unsigned i = 0; i != 8; ++i)
+			b.words[i] |= bit_of(m, i);
+	}
+	/**
+	 * @brief Returns false only if @p hash was never inserted.
+	 */
+	auto may_contain(size_t hash) const -> bool
+	{
+		if (blocks.empty())
+			return false;
+		auto m = mix(hash);
+		auto& b = blocks[block_of(m)];
+		auto ret = true;
+		for (unsigned i = 0; i != 8; ++i)
+			ret &= (b.words[i] & bit_of(m, i)) != 0;
+		return ret;
+	}
+};
+
+/**
+ * @brief Append-only storage for many small strings.
+ *
+ * Strings are copied into large chunks of memory and handed out as views.
+ * The views stay valid until the arena is destroyed or moved from, no matter
+ * how much it grows afterwards.
+ */
+template <class CharT>
+class String_Arena {
+	static constexpr size_t chunk_size = size_t(1) << 16; // in characters
+	std::vector<std::unique_ptr<CharT[]>> chunks;
+	size_t chunk_used = 0;
+	size_t chunk_capacity = 0;
+
+      public:
+	using Str_View = std::basic_string_view<CharT>;
+
+	auto store(Str_View s) -> Str_View
+	{
+		if (s.empty())
+			return {};
+		if (s.size() > chunk_capacity - chunk_used) {
+			auto n = std::max(chunk_size, s.size());
+			chunks.emplace_back(new CharT[n]);
+			chunk_used = 0;
+			chunk_capacity = n;
+		}
+		auto p = chunks.back().get() + chunk_used;
+		s.copy(p, s.size());
+		chunk_used += s.size();
+		return {p, s.size()};
+	}
+	auto clear() -> void
+	{
+		chunks.clear();
+		chunk_used = 0;
+		chunk_capacity = 0;
+	}
+};
+
+struct Extractor_Flag_Set_Ptr {
+	auto operator()(const Flag_Set* p) const
+	{
+		return std::u16string_view(p->data());
+	}
+};
+
+/**
+ * @brief Stores each distinct Flag_Set once.
+ *
+ * Dictionaries reuse a small number of flag combinations across many words,
+ * so words refer to the sets interned here. Interned sets keep their address
+ * for the lifetime of the pool, even when it is moved.
+ */
+class Flag_Set_Pool {
+	std::deque<Flag_Set> sets;
+	Hash_Multiset<const Flag_Set*, std::u16string_view,
+	              Extractor_Flag_Set_Ptr>
+	    index;
+
+      public:
+	auto intern(const Flag_Set& flags) -> const Flag_Set*
+	{
+		auto r = index.equal_range(flags.data());
+		if (r.first != r.second)
+			return *r.first;
+		auto& s = sets.emplace_back(flags);
+		index.insert(&s);
+		return &s;
+	}
+	auto size() const { return sets.size(); }
+	auto clear() -> void
+	{
+		sets.clear();
+		index = {};
 	}
 };
 
@@ -653,33 +1107,34 @@ struct Condition_Exception : public std::runtime_error {
  * @brief Limited regular expression matching used in affix entries.
  *
  * This implementation increases performance over the regex implementation in
- * the standard library.
+ * the standard library. The condition is compiled to one set of characters
+ * per position. Normal characters are sets with one element, the wildcard is
+ * an empty negated set. Each set is a bitmap over a window of 128 characters,
+ * so matching a position is one bit test.
  */
 template <class CharT>
 class Condition {
 	using Str = std::basic_string<CharT>;
-	enum Span_Type {
-		NORMAL /**< normal character */,
-		DOT /**< wildcard character */,
-		ANY_OF /**< set of possible characters */,
-		NONE_OF /**< set of excluding characters */
-	};
-	struct Span {
-		size_t pos = {};
-		size_t len = {};
-		Span_Type type = {};
-		Span() = default;
-		Span(size_t pos, size_t len, Span_Type type)
-		    : pos(pos), len(len), type(type)
-		{
-		}
+	using Str_View = std::basic_string_view<CharT>;
+	using Unsigned_Char = std::make_unsigned_t<CharT>;
+	static constexpr size_t window_size = 128;
+
+	struct Position {
+		CharT first = {};     /**< first character of the window */
+		bool negated = false; /**< matches characters not in the set */
+		bool wide = false;    /**< set does not fit in the window */
+		uint64_t bits[window_size / 64] = {};
+		size_t set_pos = 0; /**< set in cond, used when wide */
+		size_t set_len = 0;
 	};
 
 	Str cond;
-	std::vector<Span> spans; // pos, len, type
+	std::vector<Position> positions;
 	size_t length = 0;
+	bool wildcards_only = true;
 
 	auto construct() -> void;
+	auto add_position(size_t set_pos, size_t set_len, bool negated) -> void;
 
       public:
 	Condition() = default;
@@ -689,53 +1144,77 @@ class Condition {
 	auto& operator=(const Str& condition)
 	{
 		cond = condition;
-		length = 0;
 		construct();
 		return *this;
 	}
 	auto& operator=(Str&& condition)
 	{
 		cond = std::move(condition);
-		length = 0;
 		construct();
 		return *this;
 	}
 	auto& operator=(const CharT* condition)
 	{
 		cond = condition;
-		length = 0;
 		construct();
 		return *this;
 	}
-	auto match(const Str& s, size_t pos = 0, size_t len = Str::npos) const
+	auto match(Str_View s, size_t pos = 0, size_t len = Str::npos) const
 	    -> bool;
-	auto match_prefix(const Str& s) const { return match(s, 0, length); }
-	auto match_suffix(const Str& s) const
+	auto match_prefix(Str_View s) const { return match(s, 0, length); }
+	auto match_suffix(Str_View s) const
 	{
 		if (length > s.size())
 			return false;
 		return match(s, s.size() - length, length);
 	}
 };
+template <class CharT>
+auto Condition<CharT>::add_position(size_t set_pos, size_t set_len,
+                                    bool negated) -> void
+{
+	auto p = Position();
+	p.negated = negated;
+	p.set_pos = set_pos;
+	p.set_len = set_len;
+	if (set_len != 0) {
+		auto set = Str_View(cond).substr(set_pos, set_len);
+		auto lo = Unsigned_Char(*std::min_element(begin(set), end(set)));
+		auto hi = Unsigned_Char(*std::max_element(begin(set), end(set)));
+		p.first = CharT(lo);
+		if (size_t(hi) - lo >= window_size)
+			p.wide = true;
+		for (auto c : set) {
+			auto d = size_t(Unsigned_Char(c)) - lo;
+			if (d < window_size)
+				p.bits[d / 64] |= uint64_t(1) << (d % 64);
+		}
+	}
+	if (set_len != 0 || !negated)
+		wildcards_only = false;
+	positions.push_back(p);
+	++length;
+}
+
 template <class CharT>
 auto Condition<CharT>::construct() -> void
 {
+	positions.clear();
+	length = 0;
+	wildcards_only = true;
 	size_t i = 0;
 	for (; i != cond.size();) {
 		size_t j = cond.find_first_of(NUSPELL_LITERAL(CharT, "[]."), i);
 		if (i != j) {
-			if (j == cond.npos) {
-				spans.emplace_back(i, cond.size() - i, NORMAL);
-				length += cond.size() - i;
+			if (j == cond.npos)
+				j = cond.size();
+			for (; i != j; ++i)
+				add_position(i, 1, false);
+			if (i == cond.size())
 				break;
-			}
-			spans.emplace_back(i, j - i, NORMAL);
-			length += j - i;
-			i = j;
 		}
 		if (cond[i] == '.') {
-			spans.emplace_back(i, 1, DOT);
-			++length;
+			add_position(i, 0, true);
 			++i;
 			continue;
 		}
@@ -751,14 +1230,9 @@ auto Condition<CharT>::construct() -> void
 				            "closing bracket";
 				throw Condition_Exception(what);
 			}
-			Span_Type type;
-			if (cond[i] == '^') {
-				type = NONE_OF;
+			auto negated = cond[i] == '^';
+			if (negated)
 				++i;
-			}
-			else {
-				type = ANY_OF;
-			}
 			j = cond.find(']', i);
 			if (j == i) {
 				auto what = "empty bracket expression";
@@ -769,8 +1243,7 @@ auto Condition<CharT>::construct() -> void
 				            "closing bracket";
 				throw Condition_Exception(what);
 			}
-			spans.emplace_back(i, j - i, type);
-			++length;
+			add_position(i, j - i, negated);
 			i = j + 1;
 		}
 	}
@@ -785,7 +1258,7 @@ auto Condition<CharT>::construct() -> void
  * @return The valueof true when string matched condition.
  */
 template <class CharT>
-auto Condition<CharT>::match(const Str& s, size_t pos, size_t len) const -> bool
+auto Condition<CharT>::match(Str_View s, size_t pos, size_t len) const -> bool
 {
 	if (pos > s.size()) {
 		throw std::out_of_range(
@@ -795,37 +1268,103 @@ auto Condition<CharT>::match(const Str& s, size_t pos, size_t len) const -> bool
 		len = s.size() - pos;
 	if (len != length)
 		return false;
-
-	size_t i = pos;
-	for (auto& x : spans) {
-		using tr = typename Str::traits_type;
-		switch (x.type) {
-		case NORMAL:
-			if (tr::compare(&s[i], &cond[x.pos], x.len) == 0)
-				i += x.len;
-			else
-				return false;
-			break;
-		case DOT:
-			++i;
-			break;
-		case ANY_OF:
-			if (tr::find(&cond[x.pos], x.len, s[i]))
-				++i;
-			else
-				return false;
-			break;
-		case NONE_OF:
-			if (tr::find(&cond[x.pos], x.len, s[i]))
-				return false;
-			else
-				++i;
-			break;
-		}
+	if (wildcards_only)
+		return true;
+
+	using tr = typename Str::traits_type;
+	auto p = positions.data();
+	for (auto c : s.substr(pos, len)) {
+		auto d = size_t(Unsigned_Char(c)) - Unsigned_Char(p->first);
+		auto in_set = d < window_size && (p->bits[d / 64] >> (d % 64)) & 1;
+		if (p->wide && !in_set)
+			in_set = tr::find(&cond[p->set_pos], p->set_len, c);
+		if (in_set == p->negated)
+			return false;
+		++p;
 	}
 	return true;
 }
 
+enum Affixing_Mode {
+	FULL_WORD,
+	AT_COMPOUND_BEGIN,
+	AT_COMPOUND_END,
+	AT_COMPOUND_MIDDLE
+};
+
+/**
+ * @brief Word from which affixes are stripped without moving its other
+ * characters.
+ *
+ * The word is stored with free room before and after it, so replacing an
+ * affix copies only the affix. Short words with their room fit in storage
+ * inside the object and need no allocation.
+ */
+template <class CharT>
+class Root_Buffer {
+	using Str_View = std::basic_string_view<CharT>;
+	static constexpr size_t inline_size = 256;
+
+	CharT inline_data[inline_size];
+	std::unique_ptr<CharT[]> heap_data;
+	CharT* buf = inline_data;
+	size_t first = 0;
+	size_t last = 0;
+
+      public:
+	/**
+	 * @param front_room how much the word can grow at the front
+	 * @param back_room how much the word can grow at the back
+	 */
+	Root_Buffer(Str_View word, size_t front_room, size_t back_room)
+	{
+		auto size = front_room + word.size() + back_room;
+		if (size > inline_size) {
+			heap_data = std::make_unique<CharT[]>(size);
+			buf = heap_data.get();
+		}
+		first = front_room;
+		last = first + word.copy(buf + first, word.size());
+	}
+	Root_Buffer(const Root_Buffer&) = delete;
+	auto operator=(const Root_Buffer&) -> Root_Buffer& = delete;
+
+	auto view() const { return Str_View(buf + first, last - first); }
+	operator Str_View() const { return view(); }
+	auto size() const { return last - first; }
+
+	/**
+	 * @brief Replaces the first @p old_size characters with @p str.
+	 */
+	auto replace_prefix(size_t old_size, Str_View str) -> void
+	{
+		first = first + old_size - str.size();
+		str.copy(buf + first, str.size());
+	}
+	/**
+	 * @brief Replaces the last @p old_size characters with @p str.
+	 */
+	auto replace_suffix(size_t old_size, Str_View str) -> void
+	{
+		last -= old_size;
+		last += str.copy(buf + last, str.size());
+	}
+};
+
+/**
+ * @brief Properties of an affix that depend only on its continuation flags.
+ *
+ * They are computed by Aff_Data::compute_affix_properties(). NOT_VALID and
+ * VALID_INSIDE_COMPOUND are shifted left by the Affixing_Mode they apply to.
+ */
+enum Affix_Property : uint16_t {
+	NOT_VALID = 1 << 0,
+	NEEDS_AFFIX = 1 << 4,
+	IS_CIRCUMFIX = 1 << 5,
+	IS_COMPOUND_ONLY = 1 << 6,
+	VALID_INSIDE_COMPOUND = 1 << 8
+};
+
 template <class CharT>
 class Prefix {
       public:
@@ -839,11 +1378,16 @@ class Prefix {
 	Str appending;
 	Flag_Set cont_flags;
 	Cond condition;
+	uint16_t properties = 0; /**< Affix_Property bits */
 
 	auto to_root(Str& word) const -> Str&
 	{
 		return word.replace(0, appending.size(), stripping);
 	}
+	auto to_root(Root_Buffer<CharT>& word) const -> void
+	{
+		word.replace_prefix(appending.size(), stripping);
+	}
 	auto to_root_copy(Str word) const -> Str
 	{
 		to_root(word);
@@ -854,13 +1398,17 @@ class Prefix {
 	{
 		return word.replace(0, stripping.size(), appending);
 	}
+	auto to_derived(Root_Buffer<CharT>& word) const -> void
+	{
+		word.replace_prefix(stripping.size(), appending);
+	}
 	auto to_derived_copy(Str word) const -> Str
 	{
 		to_derived(word);
 		return word;
 	}
 
-	auto check_condition(const Str& word) const -> bool
+	auto check_condition(std::basic_string_view<CharT> word) const -> bool
 	{
 		return condition.match_prefix(word);
 	}
@@ -879,12 +1427,17 @@ class Suffix {
 	Str appending;
 	Flag_Set cont_flags;
 	Cond condition;
+	uint16_t properties = 0; /**< Affix_Property bits */
 
 	auto to_root(Str& word) const -> Str&
 	{
 		return word.replace(word.size() - appending.size(),
 		                    appending.size(), stripping);
 	}
+	auto to_root(Root_Buffer<CharT>& word) const -> void
+	{
+		word.replace_suffix(appending.size(), stripping);
+	}
 	auto to_root_copy(Str word) const -> Str
 	{
 		to_root(word);
@@ -896,18 +1449,29 @@ class Suffix {
 		return word.replace(word.size() - stripping.size(),
 		                    stripping.size(), appending);
 	}
+	auto to_derived(Root_Buffer<CharT>& word) const -> void
+	{
+		word.replace_suffix(stripping.size(), appending);
+	}
 	auto to_derived_copy(Str word) const -> Str
 	{
 		to_derived(word);
 		return word;
 	}
 
-	auto check_condition(const Str& word) const -> bool
+	auto check_condition(std::basic_string_view<CharT> word) const -> bool
 	{
 		return condition.match_suffix(word);
 	}
 };
 
+/**
+ * @brief Multiset that finds all elements whose key is a prefix of a word.
+ *
+ * The keys are indexed in a double-array trie. Finding all elements with key
+ * that is a prefix of a word is one walk down the trie, one array access per
+ * character of the word.
+ */
 template <class T, class Key_Extr = identity, class Key_Transform = identity>
 class Prefix_Multiset {
       public:
@@ -916,6 +1480,7 @@ class Prefix_Multiset {
 	    std::declval<Key_Extr>()(std::declval<T>()))>;
 	using Char_Type = typename Key_Type::value_type;
 	using Traits = typename Key_Type::traits_type;
+	using Key_View = std::basic_string_view<Char_Type, Traits>;
 	using Vector_Type = std::vector<T>;
 	using Iterator = typename Vector_Type::const_iterator;
 
@@ -927,62 +1492,189 @@ class Prefix_Multiset {
 	struct Ebo : public Ebo_Key_Extr, Ebo_Key_Transf {
 		Vector_Type table;
 	} ebo;
-	std::basic_string<Char_Type> first_letter;
-	std::vector<size_t> prefix_idx_with_first_letter;
+
+	struct Trie_Node {
+		size_t base = 0;  // children are at base + code of char
+		size_t check = 0; // parent, npos if the slot is free
+		size_t first = 0; // elements with key ending at this node
+		size_t last = 0;
+	};
+	static constexpr auto npos = size_t(-1);
+	std::vector<Trie_Node> trie = std::vector<Trie_Node>(1);
+	// Chars of the keys are numbered from 1 in increasing order. The codes
+	// of the densest window of chars are in a table, the rest are in a
+	// vector sorted by char, so keys in several scripts stay cheap.
+	static constexpr size_t dense_window = 256;
+	std::vector<uint32_t> dense_codes; // of c is dense_codes[c - dense_first]
+	size_t dense_first = 0;
+	std::vector<std::pair<uint32_t, uint32_t>> sparse_codes;
 
 	auto key_extractor() const -> const Ebo_Key_Extr& { return ebo; }
 	auto key_transformator() const -> const Ebo_Key_Transf& { return ebo; }
 	auto& get_table() { return ebo.table; }
 	auto& get_table() const { return ebo.table; }
 
+	static auto to_size_t(Char_Type c)
+	{
+		return size_t(std::make_unsigned_t<Char_Type>(c));
+	}
+	auto char_code(Char_Type c) const -> size_t
+	{
+		auto u = to_size_t(c);
+		auto i = u - dense_first;
+		if (i < dense_codes.size())
+			return dense_codes[i];
+		if (sparse_codes.empty())
+			return 0;
+		auto it = std::lower_bound(
+		    std::begin(sparse_codes), std::end(sparse_codes), u,
+		    [](auto& p, size_t x) { return p.first < x; });
+		if (it == std::end(sparse_codes) || it->first != u)
+			return 0;
+		return it->second;
+	}
+	/**
+	 * @brief Returns child of @p node for char @p c, or 0 if there is
+	 * none. The root is never a child.
+	 */
+	auto child(size_t node, Char_Type c) const -> size_t
+	{
+		auto code = char_code(c);
+		if (code == 0)
+			return 0;
+		auto i = trie[node].base + code;
+		if (i >= trie.size() || trie[i].check != node)
+			return 0;
+		return i;
+	}
+
 	auto sort()
 	{
 		auto& extract_key = key_extractor();
 		auto& transform_key = key_transformator();
 		auto& table = get_table();
 
-		std::sort(begin(table), end(table), [&](T& a, T& b) {
+		auto less = [&](const T& a, const T& b) {
 			auto&& key_a = transform_key(extract_key(a));
 			auto&& key_b = transform_key(extract_key(b));
 			return key_a < key_b;
-		});
-
-		first_letter.clear();
-		prefix_idx_with_first_letter.clear();
-		auto first = begin(table);
-		auto last = end(table);
-		auto it = std::find_if_not(first, last, [=](const T& x) {
-			auto&& k = transform_key(extract_key(x));
-			return k.empty();
-		});
-		while (it != last) {
-			auto&& k1 = transform_key(extract_key(*it));
-			first_letter.push_back(k1[0]);
-			prefix_idx_with_first_letter.push_back(it - first);
-
-			it = std::upper_bound(
-			    it, last, k1[0],
-			    Comparator{0, extract_key, transform_key});
-		}
-		if (!prefix_idx_with_first_letter.empty())
-			prefix_idx_with_first_letter.push_back(last - first);
-	}
-
-	struct Comparator {
-		size_t i;
-		Key_Extr extract_key;
-		Key_Transform transform_key;
-		auto operator()(const T& a, Char_Type b) const
-		{
-			auto&& key_a = transform_key(extract_key(a));
-			return Traits::lt(key_a[i], b);
+		};
+		std::stable_sort(begin(table), end(table), less);
+		build_trie();
+	}
+
+	auto build_trie() -> void
+	{
+		auto& extract_key = key_extractor();
+		auto& transform_key = key_transformator();
+		auto& table = get_table();
+
+		auto chars = std::vector<size_t>();
+		for (auto& x : table)
+			for (auto c : transform_key(extract_key(x)))
+				chars.push_back(to_size_t(c));
+		std::sort(std::begin(chars), std::end(chars));
+		chars.erase(std::unique(std::begin(chars), std::end(chars)),
+		            std::end(chars));
+
+		// window [chars[best], chars[best] + dense_window) with the
+		// most chars
+		auto best = size_t(0);
+		auto best_count = size_t(0);
+		for (size_t i = 0, j = 0; j != chars.size(); ++j) {
+			while (chars[j] - chars[i] >= dense_window)
+				++i;
+			if (j - i + 1 > best_count) {
+				best = i;
+				best_count = j - i + 1;
+			}
 		}
-		auto operator()(Char_Type a, const T& b) const
-		{
-			auto&& key_b = transform_key(extract_key(b));
-			return Traits::lt(a, key_b[i]);
+		dense_codes.clear();
+		sparse_codes.clear();
+		dense_first = 0;
+		if (!chars.empty()) {
+			dense_first = chars[best];
+			auto dense_last = chars[best + best_count - 1];
+			dense_codes.resize(dense_last - dense_first + 1);
 		}
-	};
+		for (size_t i = 0; i != chars.size(); ++i) {
+			auto c = chars[i];
+			auto code = uint32_t(i + 1);
+			if (c - dense_first < dense_codes.size())
+				dense_codes[c - dense_first] = code;
+			else
+				sparse_codes.emplace_back(uint32_t(c), code);
+		}
+
+		trie.assign(1, Trie_Node());
+		auto first_free = size_t(1);
+		if (!table.empty())
+			build_node(0, 0, 0, table.size(), first_free);
+	}
+
+	/**
+	 * @brief Builds the subtrie of elements [first, last) of the table
+	 * that share the first @p depth characters of the key.
+	 * @param first_free no slot before it is free.
+	 */
+	auto build_node(size_t node, size_t depth, size_t first, size_t last,
+	                size_t& first_free) -> void
+	{
+		auto& extract_key = key_extractor();
+		auto& transform_key = key_transformator();
+		auto& table = get_table();
+		auto key_at = [&](size_t i) -> decltype(auto) {
+			return transform_key(extract_key(table[i]));
+		};
+
+		auto i = first;
+		while (i != last && key_at(i).size() == depth)
+			++i;
+		trie[node].first = first;
+		trie[node].last = i;
+
+		// children as [char code, first element, last element)
+		auto children = std::vector<std::array<size_t, 3>>();
+		while (i != last) {
+			auto c = key_at(i)[depth];
+			auto j = i + 1;
+			while (j != last && Traits::eq(key_at(j)[depth], c))
+				++j;
+			children.push_back({char_code(c), i, j});
+			i = j;
+		}
+		if (children.empty())
+			return;
+
+		auto lowest_code = children.front()[0];
+		auto base = std::max(first_free, lowest_code + 1) - lowest_code;
+		for (;; ++base) {
+			auto free = std::all_of(
+			    std::begin(children), std::end(children),
+			    [&](auto& ch) {
+				    auto k = base + ch[0];
+				    return k >= trie.size() ||
+				           trie[k].check == npos;
+			    });
+			if (free)
+				break;
+		}
+		auto max_idx = base + children.back()[0];
+		if (max_idx >= trie.size()) {
+			auto n = Trie_Node();
+			n.check = npos;
+			trie.resize(max_idx + 1, n);
+		}
+		trie[node].base = base;
+		for (auto& ch : children)
+			trie[base + ch[0]].check = node;
+		while (first_free != trie.size() &&
+		       trie[first_free].check != npos)
+			++first_free;
+		for (auto& ch : children)
+			build_node(base + ch[0], depth + 1, ch[1], ch[2],
+			           first_free);
+	}
 
       public:
 	Prefix_Multiset() = default;
@@ -1028,6 +1720,17 @@ class Prefix_Multiset {
 	}
 	auto& data() const { return get_table(); }
 
+	/**
+	 * @brief Calls @p func on every element, which must not change its
+	 * key.
+	 */
+	template <class Func>
+	auto for_each_mutable(Func func) -> void
+	{
+		for (auto& x : get_table())
+			func(x);
+	}
+
 	template <class Func>
 	auto for_each_prefixes_of(const Key_Type& word, Func func) const;
 
@@ -1042,8 +1745,9 @@ class Prefix_Multiset {
 		const Prefix_Multiset* set = {};
 		Iterator it = {};
 		Iterator last = {};
-		const Key_Type* search_key = {};
+		Key_View search_key = {};
 		size_t len = {};
+		size_t node = {};
 		bool valid = false;
 
 		auto advance() -> void;
@@ -1057,17 +1761,17 @@ class Prefix_Multiset {
 		using pointer = const T*;
 
 		Iter_Prefixes_Of() = default;
-		Iter_Prefixes_Of(const Prefix_Multiset& set,
-		                 const Key_Type& word)
+		Iter_Prefixes_Of(const Prefix_Multiset& set, Key_View word)
 		    : set(&set), it(set.get_table().begin()),
-		      last(set.get_table().end()), search_key(&word),
+		      last(set.get_table().begin()), search_key(word),
 		      valid(true)
 		{
+			auto& root = set.trie[0];
+			last += root.last;
 			advance();
 		}
 		Iter_Prefixes_Of(const Prefix_Multiset&, Key_Type&&) = delete;
-		Iter_Prefixes_Of(Prefix_Multiset&&, const Key_Type&) = delete;
-		Iter_Prefixes_Of(Prefix_Multiset&&, Key_Type&&) = delete;
+		Iter_Prefixes_Of(Prefix_Multiset&&, Key_View) = delete;
 
 		auto& operator++()
 		{
@@ -1098,7 +1802,12 @@ class Prefix_Multiset {
 		auto end() const { return Iter_Prefixes_Of(); }
 	};
 
-	auto iterate_prefixes_of(const Key_Type& word) const
+	/**
+	 * @brief Iterates the elements whose keys are prefixes of @p word.
+	 *
+	 * The characters of @p word must not change while iterating.
+	 */
+	auto iterate_prefixes_of(Key_View word) const
 	{
 		return Iter_Prefixes_Of(*this, word);
 	}
@@ -1108,56 +1817,24 @@ template <class T, class Key_Extr, class Key_Transform>
 auto Prefix_Multiset<T, Key_Extr, Key_Transform>::Iter_Prefixes_Of::advance()
     -> void
 {
-	auto& extract_key = set->key_extractor();
+	if (it != last)
+		return;
 	auto& transform_key = set->key_transformator();
-	auto& table = set->get_table();
-
-	if (len == 0) {
-		if (it != last) {
-			if (transform_key(extract_key(*it)).empty())
-				return;
-			if (transform_key(*search_key).empty()) {
-				valid = false;
-				return;
-			}
-
-			auto& first_letter = set->first_letter;
-			auto& prefix_idx_with_first_letter =
-			    set->prefix_idx_with_first_letter;
-			auto idx =
-			    first_letter.find(transform_key(*search_key)[0]);
-			if (idx == first_letter.npos) {
-				valid = false;
-				return;
-			}
-
-			auto first = table.begin();
-			it = first + prefix_idx_with_first_letter[idx];
-			last = first + prefix_idx_with_first_letter[idx + 1];
-			++len;
-		}
-		else {
-			valid = false;
-			return;
-		}
-	}
-	for (;; ++len) {
-		if (it != last) {
-			if (transform_key(extract_key(*it)).size() == len)
-				return;
-			if (len == transform_key(*search_key).size()) {
-				valid = false;
-				break;
-			}
-		}
-		else {
-			valid = false;
+	auto&& key = transform_key(search_key);
+	auto first = set->get_table().begin();
+	while (len != key.size()) {
+		node = set->child(node, key[len]);
+		if (node == 0)
 			break;
+		++len;
+		auto& n = set->trie[node];
+		if (n.first != n.last) {
+			it = first + n.first;
+			last = first + n.last;
+			return;
 		}
-		tie(it, last) =
-		    equal_range(it, last, transform_key(*search_key)[len],
-		                Comparator{len, extract_key, transform_key});
 	}
+	valid = false;
 }
 
 template <class T, class Key_Extr, class Key_Transform>
@@ -1165,46 +1842,19 @@ template <class Func>
 auto Prefix_Multiset<T, Key_Extr, Key_Transform>::for_each_prefixes_of(
     const Key_Type& word, Func func) const
 {
-	auto& extract_key = key_extractor();
 	auto& transform_key = key_transformator();
 	auto& table = get_table();
+	auto&& key = transform_key(word);
 
-	auto first = begin(table);
-	auto last = end(table);
-	auto it = first;
-	for (; it != last; ++it) {
-		auto&& k = transform_key(extract_key(*it));
-		if (k.empty())
-			func(*it);
-		else
+	for (size_t node = 0, len = 0;; ++len) {
+		auto& n = trie[node];
+		for (auto i = n.first; i != n.last; ++i)
+			func(table[i]);
+		if (len == key.size())
 			break;
-	}
-
-	if (it == last)
-		return;
-	if (transform_key(word).empty())
-		return;
-
-	auto idx = first_letter.find(transform_key(word)[0]);
-	if (idx == first_letter.npos)
-		return;
-	first = begin(table) + prefix_idx_with_first_letter[idx];
-	last = begin(table) + prefix_idx_with_first_letter[idx + 1];
-
-	for (size_t len = 1;; ++len) {
-		it = first;
-		for (; it != last &&
-		       transform_key(extract_key(*it)).size() == len;
-		     ++it) {
-			func(*it);
-		}
-		if (it == last)
+		node = child(node, key[len]);
+		if (node == 0)
 			break;
-		if (len == transform_key(word).size())
-			break;
-		tie(first, last) =
-		    equal_range(it, last, transform_key(word)[len],
-		                Comparator{len, extract_key, transform_key});
 	}
 }
 
@@ -1215,7 +1865,8 @@ class Reversed_String_View {
 	using traits_type = typename Str::traits_type;
 	using value_type = typename Str::value_type;
 	using size_type = typename Str::size_type;
-	using const_iterator = typename Str::const_reverse_iterator;
+	using Str_View = std::basic_string_view<CharT>;
+	using const_iterator = std::reverse_iterator<const CharT*>;
 
       private:
 	const_iterator first = {};
@@ -1223,7 +1874,10 @@ class Reversed_String_View {
 
       public:
 	Reversed_String_View() = default;
-	explicit Reversed_String_View(const Str& s) : first(s.rbegin()), sz(s.size()) {}
+	explicit Reversed_String_View(Str_View s)
+	    : first(s.data() + s.size()), sz(s.size())
+	{
+	}
 	explicit Reversed_String_View(Str&& s) = delete;
 	auto& operator[](size_type i) const { return first[i]; }
 	auto size() const { return sz; }
@@ -1243,12 +1897,17 @@ struct String_Reverser {
 	{
 		return Reversed_String_View<CharT>(x);
 	}
+	auto operator()(std::basic_string_view<CharT> x) const
+	{
+		return Reversed_String_View<CharT>(x);
+	}
 	// auto operator()(T&& x) const = delete;
 };
 
 template <class AffixT>
 struct Extractor_Of_Appending_From_Affix {
 	auto& operator()(const AffixT& a) const { return a.appending; }
+	auto& operator()(const AffixT* a) const { return a->appending; }
 };
 
 template <class T, class Key_Extr = identity>
@@ -1264,21 +1923,50 @@ class Prefix_Table {
 	using Prefix_Multiset_Type =
 	    Prefix_Multiset<Prefix<wchar_t>,
 	                    Extractor_Of_Appending_From_Affix<Prefix<wchar_t>>>;
+	using By_Flag_Multiset_Type =
+	    Prefix_Multiset<const Prefix<wchar_t>*,
+	                    Extractor_Of_Appending_From_Affix<Prefix<wchar_t>>>;
 	using Key_Type = typename Prefix_Multiset_Type::Key_Type;
 	using Vector_Type = typename Prefix_Multiset_Type::Vector_Type;
 	Prefix_Multiset_Type table;
 	Flag_Set all_cont_flags;
+	// by_cont_flag[i] has the affixes with all_cont_flags[i] in cont_flags
+	std::vector<By_Flag_Multiset_Type> by_cont_flag;
+	size_t max_stripping = 0;
 
 	auto populate()
 	{
-		for (auto& x : table.data())
+		all_cont_flags = {};
+		max_stripping = 0;
+		for (auto& x : table.data()) {
 			all_cont_flags += x.cont_flags;
+			max_stripping =
+			    std::max(max_stripping, x.stripping.size());
+		}
+		auto lists = std::vector<std::vector<const Prefix<wchar_t>*>>(
+		    all_cont_flags.size());
+		for (auto& x : table.data())
+			for (auto f : x.cont_flags)
+				lists[all_cont_flags.lower_bound(f) -
+				      all_cont_flags.begin()]
+				    .push_back(&x);
+		by_cont_flag.assign(std::make_move_iterator(lists.begin()),
+		                    std::make_move_iterator(lists.end()));
 	}
 
       public:
 	Prefix_Table() = default;
 	explicit Prefix_Table(const Vector_Type& t) : table(t) { populate(); }
 	explicit Prefix_Table(Vector_Type&& t) : table(std::move(t)) { populate(); }
+	Prefix_Table(const Prefix_Table& other) : table(other.table) { populate(); }
+	Prefix_Table(Prefix_Table&&) = default;
+	auto& operator=(const Prefix_Table& other)
+	{
+		table = other.table;
+		populate();
+		return *this;
+	}
+	auto operator=(Prefix_Table&&) -> Prefix_Table& = default;
 	auto& operator=(const Vector_Type& t)
 	{
 		table = t;
@@ -1294,6 +1982,21 @@ class Prefix_Table {
 	auto begin() const { return table.data().begin(); }
 	auto end() const { return table.data().end(); }
 
+	/**
+	 * @brief Sets the properties of every affix to @p func(affix).
+	 */
+	template <class Func>
+	auto set_properties(Func func) -> void
+	{
+		table.for_each_mutable(
+		    [&](Prefix<wchar_t>& x) { x.properties = func(x); });
+	}
+
+	/**
+	 * @brief Length of the longest stripping, the most that stripping
+	 * one affix can lengthen a word.
+	 */
+	auto max_stripping_size() const { return max_stripping; }
 	auto has_continuation_flags() const
 	{
 		return all_cont_flags.size() != 0;
@@ -1302,32 +2005,79 @@ class Prefix_Table {
 	{
 		return all_cont_flags.contains(flag);
 	}
-	auto iterate_prefixes_of(const Key_Type& word) const
+	auto iterate_prefixes_of(std::wstring_view word) const
 	{
 		return table.iterate_prefixes_of(word);
 	}
 	auto iterate_prefixes_of(Key_Type&& word) const = delete;
+
+	/**
+	 * @brief Iterates the affixes that are prefixes of @p word and have
+	 * @p cont_flag among their continuation flags.
+	 *
+	 * The iterator points to pointers to affixes.
+	 */
+	auto iterate_prefixes_of(std::wstring_view word,
+	                         char16_t cont_flag) const
+	{
+		auto i = all_cont_flags.lower_bound(cont_flag);
+		if (i == all_cont_flags.end() || *i != cont_flag)
+			return typename By_Flag_Multiset_Type::Iter_Prefixes_Of();
+		auto& set = by_cont_flag[i - all_cont_flags.begin()];
+		return set.iterate_prefixes_of(word);
+	}
+	auto iterate_prefixes_of(Key_Type&& word, char16_t cont_flag) const =
+	    delete;
 };
 
 class Suffix_Table {
 	using Suffix_Multiset_Type =
 	    Suffix_Multiset<Suffix<wchar_t>,
 	                    Extractor_Of_Appending_From_Affix<Suffix<wchar_t>>>;
+	using By_Flag_Multiset_Type =
+	    Suffix_Multiset<const Suffix<wchar_t>*,
+	                    Extractor_Of_Appending_From_Affix<Suffix<wchar_t>>>;
 	using Key_Type = typename Suffix_Multiset_Type::Key_Type;
 	using Vector_Type = typename Suffix_Multiset_Type::Vector_Type;
 	Suffix_Multiset_Type table;
 	Flag_Set all_cont_flags;
+	// by_cont_flag[i] has the affixes with all_cont_flags[i] in cont_flags
+	std::vector<By_Flag_Multiset_Type> by_cont_flag;
+	size_t max_stripping = 0;
 
 	auto populate()
 	{
-		for (auto& x : table.data())
+		all_cont_flags = {};
+		max_stripping = 0;
+		for (auto& x : table.data()) {
 			all_cont_flags += x.cont_flags;
+			max_stripping =
+			    std::max(max_stripping, x.stripping.size());
+		}
+		auto lists = std::vector<std::vector<const Suffix<wchar_t>*>>(
+		    all_cont_flags.size());
+		for (auto& x : table.data())
+			for (auto f : x.cont_flags)
+				lists[all_cont_flags.lower_bound(f) -
+				      all_cont_flags.begin()]
+				    .push_back(&x);
+		by_cont_flag.assign(std::make_move_iterator(lists.begin()),
+		                    std::make_move_iterator(lists.end()));
 	}
 
       public:
 	Suffix_Table() = default;
 	explicit Suffix_Table(const Vector_Type& t) : table(t) { populate(); }
 	explicit Suffix_Table(Vector_Type&& t) : table(std::move(t)) { populate(); }
+	Suffix_Table(const Suffix_Table& other) : table(other.table) { populate(); }
+	Suffix_Table(Suffix_Table&&) = default;
+	auto& operator=(const Suffix_Table& other)
+	{
+		table = other.table;
+		populate();
+		return *this;
+	}
+	auto operator=(Suffix_Table&&) -> Suffix_Table& = default;
 	auto& operator=(const Vector_Type& t)
 	{
 		table = t;
@@ -1343,6 +2093,21 @@ class Suffix_Table {
 	auto begin() const { return table.data().begin(); }
 	auto end() const { return table.data().end(); }
 
+	/**
+	 * @brief Sets the properties of every affix to @p func(affix).
+	 */
+	template <class Func>
+	auto set_properties(Func func) -> void
+	{
+		table.for_each_mutable(
+		    [&](Suffix<wchar_t>& x) { x.properties = func(x); });
+	}
+
+	/**
+	 * @brief Length of the longest stripping, the most that stripping
+	 * one affix can lengthen a word.
+	 */
+	auto max_stripping_size() const { return max_stripping; }
 	auto has_continuation_flags() const
 	{
 		return all_cont_flags.size() != 0;
@@ -1351,11 +2116,29 @@ class Suffix_Table {
 	{
 		return all_cont_flags.contains(flag);
 	}
-	auto iterate_suffixes_of(const Key_Type& word) const
+	auto iterate_suffixes_of(std::wstring_view word) const
 	{
 		return table.iterate_prefixes_of(word);
 	}
 	auto iterate_suffixes_of(Key_Type&& word) const = delete;
+
+	/**
+	 * @brief Iterates the affixes that are suffixes of @p word and have
+	 * @p cont_flag among their continuation flags.
+	 *
+	 * The iterator points to pointers to affixes.
+	 */
+	auto iterate_suffixes_of(std::wstring_view word,
+	                         char16_t cont_flag) const
+	{
+		auto i = all_cont_flags.lower_bound(cont_flag);
+		if (i == all_cont_flags.end() || *i != cont_flag)
+			return typename By_Flag_Multiset_Type::Iter_Prefixes_Of();
+		auto& set = by_cont_flag[i - all_cont_flags.begin()];
+		return set.iterate_prefixes_of(word);
+	}
+	auto iterate_suffixes_of(Key_Type&& word, char16_t cont_flag) const =
+	    delete;
 };
 
 template <class CharT>
@@ -1419,42 +2202,77 @@ struct Compound_Pattern {
 	bool match_first_only_unaffixed_or_zero_affixed = false;
 };
 
+/**
+ * @brief The COMPOUNDRULE patterns compiled into one automaton over flags.
+ *
+ * Every item of every rule is a position of a nondeterministic automaton and
+ * a state is the bit set of the positions that can match the next word, plus
+ * the positions after the end of each rule. Feeding the flags of a word
+ * advances all rules at once with a few bitwise operations per flag, so a
+ * compound walk can carry the state from part to part and stop as soon as no
+ * rule can match.
+ *
+ * States are arrays of state_size() words owned by the caller.
+ */
 class Compound_Rule_Table {
 	std::vector<std::u16string> rules;
 	Flag_Set all_flags;
+	size_t num_words = 0;
+	std::vector<uint64_t> start;      // initial state
+	std::vector<uint64_t> optional;   // items with ? or *
+	std::vector<uint64_t> repeatable; // items with *
+	std::vector<uint64_t> accepting;  // ends of rules
+	std::vector<uint64_t> flag_masks; // items of each flag of all_flags
 
 	auto fill_all_flags() -> void;
+	auto compile() -> void;
+	auto close(uint64_t* state) const -> void;
 
       public:
 	Compound_Rule_Table() = default;
-	explicit Compound_Rule_Table(const std::vector<std::u16string>& tbl) : rules(tbl)
+	explicit Compound_Rule_Table(const std::vector<std::u16string>& tbl)
+	    : rules(tbl)
 	{
 		fill_all_flags();
+		compile();
 	}
 	explicit Compound_Rule_Table(std::vector<std::u16string>&& tbl)
 	    : rules(move(tbl))
 	{
 		fill_all_flags();
+		compile();
 	}
 	auto& operator=(const std::vector<std::u16string>& tbl)
 	{
 		rules = tbl;
 		fill_all_flags();
+		compile();
 		return *this;
 	}
 	auto& operator=(std::vector<std::u16string>&& tbl)
 	{
 		rules = move(tbl);
 		fill_all_flags();
+		compile();
 		return *this;
 	}
 	auto empty() const { return rules.empty(); }
 	auto has_any_of_flags(const Flag_Set& f) const -> bool;
 	auto match_any_rule(const std::vector<const Flag_Set*>& data) const
 	    -> bool;
+
+	auto state_size() const { return num_words; }
+	auto initial_state(uint64_t* state) const -> void
+	{
+		std::copy(begin(start), end(start), state);
+	}
+	auto advance(const uint64_t* from, const Flag_Set& flags,
+	             uint64_t* to) const -> bool;
+	auto is_accepting(const uint64_t* state) const -> bool;
 };
 auto inline Compound_Rule_Table::fill_all_flags() -> void
 {
+	all_flags.clear();
 	for (auto& f : rules) {
 		all_flags += f;
 	}
@@ -1462,6 +2280,107 @@ auto inline Compound_Rule_Table::fill_all_flags() -> void
 	all_flags.erase(u'*');
 }
 
+auto inline Compound_Rule_Table::compile() -> void
+{
+	auto num_positions = size_t(0);
+	for (auto& r : rules) {
+		auto num_quantifiers = std::count(begin(r), end(r), u'?') +
+		                       std::count(begin(r), end(r), u'*');
+		num_positions += r.size() - num_quantifiers + 1;
+	}
+	num_words = (num_positions + 63) / 64;
+	start.assign(num_words, 0);
+	optional.assign(num_words, 0);
+	repeatable.assign(num_words, 0);
+	accepting.assign(num_words, 0);
+	flag_masks.assign(all_flags.size() * num_words, 0);
+	auto set_bit = [](std::vector<uint64_t>& v, size_t i, size_t pos) {
+		v[i + pos / 64] |= uint64_t(1) << pos % 64;
+	};
+	auto pos = size_t(0);
+	for (auto& r : rules) {
+		set_bit(start, 0, pos);
+		for (size_t i = 0; i != r.size(); ++i) {
+			auto flag = r[i];
+			if (flag == u'?' || flag == u'*')
+				continue;
+			auto f = all_flags.find(flag) - all_flags.begin();
+			set_bit(flag_masks, f * num_words, pos);
+			if (i + 1 != r.size() && r[i + 1] == u'?') {
+				set_bit(optional, 0, pos);
+			}
+			else if (i + 1 != r.size() && r[i + 1] == u'*') {
+				set_bit(optional, 0, pos);
+				set_bit(repeatable, 0, pos);
+			}
+			++pos;
+		}
+		set_bit(accepting, 0, pos);
+		++pos;
+	}
+	close(start.data());
+}
+
+/**
+ * @brief Adds to @p state the positions reachable by skipping optional items.
+ */
+auto inline Compound_Rule_Table::close(uint64_t* state) const -> void
+{
+	for (auto changed = true; changed;) {
+		changed = false;
+		auto carry = uint64_t(0);
+		for (size_t i = 0; i != num_words; ++i) {
+			auto skip = state[i] & optional[i];
+			auto next = state[i] | skip << 1 | carry;
+			carry = skip >> 63;
+			changed |= next != state[i];
+			state[i] = next;
+		}
+	}
+}
+
+/**
+ * @brief Feeds the flags of one word to the automaton.
+ * @return false if no rule can match anymore.
+ */
+auto inline Compound_Rule_Table::advance(const uint64_t* from,
+                                         const Flag_Set& flags,
+                                         uint64_t* to) const -> bool
+{
+	std::fill_n(to, num_words, 0);
+	auto f = all_flags.begin();
+	for (auto flag : flags) {
+		f = std::lower_bound(f, all_flags.end(), flag);
+		if (f == all_flags.end())
+			break;
+		if (*f != flag)
+			continue;
+		auto mask = &flag_masks[(f - all_flags.begin()) * num_words];
+		auto carry = uint64_t(0);
+		for (size_t i = 0; i != num_words; ++i) {
+			auto matched = from[i] & mask[i];
+			auto moved = matched & ~repeatable[i];
+			to[i] |= matched & repeatable[i];
+			to[i] |= moved << 1 | carry;
+			carry = moved >> 63;
+		}
+	}
+	close(to);
+	auto alive = uint64_t(0);
+	for (size_t i = 0; i != num_words; ++i)
+		alive |= to[i];
+	return alive;
+}
+
+auto inline Compound_Rule_Table::is_accepting(const uint64_t* state) const
+    -> bool
+{
+	for (size_t i = 0; i != num_words; ++i)
+		if (state[i] & accepting[i])
+			return true;
+	return false;
+}
+
 auto inline Compound_Rule_Table::has_any_of_flags(const Flag_Set& f) const
     -> bool
 {
@@ -1549,9 +2468,16 @@ auto inline match_compund_rule(const std::vector<const Flag_Set*>& words_data,
 auto inline Compound_Rule_Table::match_any_rule(
     const std::vector<const Flag_Set*>& data) const -> bool
 {
-	return any_of(begin(rules), end(rules), [&](const std::u16string& p) {
-		return match_compund_rule(data, p);
-	});
+	auto states = std::vector<uint64_t>(2 * num_words);
+	auto state = states.data();
+	auto next = state + num_words;
+	initial_state(state);
+	for (auto flags : data) {
+		if (!advance(state, *flags, next))
+			return false;
+		std::swap(state, next);
+	}
+	return is_accepting(state);
 }
 
 template <class CharT>
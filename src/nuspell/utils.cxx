@@ -19,15 +19,52 @@
 #include "utils.hxx"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <limits>
+#include <random>
 
 #include <boost/locale/utf8_codecvt.hpp>
 
 #include <unicode/uchar.h>
 #include <unicode/ucnv.h>
+#include <unicode/uscript.h>
 #include <unicode/unistr.h>
 #include <unicode/ustring.h>
 
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NUSPELL_SSE2 1
+#include <emmintrin.h>
+#else
+#define NUSPELL_SSE2 0
+#endif
+
+// AVX2 code is compiled with function attributes and used only if the CPU
+// supports it at runtime.
+#if NUSPELL_SSE2 && (defined(__GNUC__) || defined(__clang__)) &&              \
+    (defined(__x86_64__) || defined(__i386__))
+#define NUSPELL_AVX2_DISPATCH 1
+#include <immintrin.h>
+#else
+#define NUSPELL_AVX2_DISPATCH 0
+#endif
+
+#ifdef _POSIX_VERSION
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <process.h>
+#include <windows.h>
+#endif
+
 #if ' ' != 32 || '.' != 46 || 'A' != 65 || 'Z' != 90 || 'a' != 97 || 'z' != 122
 #error "Basic execution character set is not ASCII"
 #elif L' ' != 32 || L'.' != 46 || L'A' != 65 || L'Z' != 90 || L'a' != 97 ||    \
@@ -141,13 +178,6 @@ auto static utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out)
 	return valid;
 }
 
-template <class InChar, class OutContainer>
-auto static valid_utf_to_utf(const std::basic_string<InChar>& in,
-                             OutContainer& out) -> void
-{
-	utf_to_utf<Utf_Error_Handling::ALWAYS_VALID>(in, out);
-}
-
 template <class InChar, class OutContainer>
 auto static utf_to_utf_my(const std::basic_string<InChar>& in,
                           OutContainer& out) -> bool
@@ -155,21 +185,215 @@ auto static utf_to_utf_my(const std::basic_string<InChar>& in,
 	return utf_to_utf<Utf_Error_Handling::REPLACE>(in, out);
 }
 
-auto wide_to_utf8(const std::wstring& in, std::string& out) -> void
+auto static is_ascii(char c) -> bool
+{
+	return static_cast<unsigned char>(c) <= 127;
+}
+
+namespace {
+// The leading ASCII characters are converted with the widest vectors the CPU
+// has. The kernels return the number of converted characters, the callers
+// convert the rest one code point at a time.
+
+auto widen_ascii_scalar(const char* in, size_t n, wchar_t* out) -> size_t
 {
-#if U_SIZEOF_WCHAR_T == 4
-	valid_utf_to_utf(in, out);
+	auto i = size_t(0);
+	for (; n - i >= 8; i += 8) {
+		uint64_t block;
+		memcpy(&block, in + i, 8);
+		if (block & 0x8080808080808080)
+			break;
+		for (size_t j = 0; j != 8; ++j)
+			out[i + j] = in[i + j];
+	}
+	for (; i != n && is_ascii(in[i]); ++i)
+		out[i] = in[i];
+	return i;
+}
+
+auto narrow_ascii_scalar(const wchar_t* in, size_t n, char* out) -> size_t
+{
+	auto i = size_t(0);
+	for (; i != n; ++i) {
+		auto c = static_cast<make_unsigned_t<wchar_t>>(in[i]);
+		if (c > 127)
+			break;
+		out[i] = char(c);
+	}
+	return i;
+}
+
+#if NUSPELL_SSE2
+auto widen_ascii_sse2(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	auto i = size_t(0);
+	auto zero = _mm_setzero_si128();
+	for (; n - i >= 16; i += 16) {
+		auto p = reinterpret_cast<const __m128i*>(in + i);
+		auto v = _mm_loadu_si128(p);
+		if (_mm_movemask_epi8(v))
+			break;
+		auto lo = _mm_unpacklo_epi8(v, zero);
+		auto hi = _mm_unpackhi_epi8(v, zero);
+		auto o = reinterpret_cast<__m128i*>(out + i);
+		if constexpr (sizeof(wchar_t) == 2) {
+			_mm_storeu_si128(o, lo);
+			_mm_storeu_si128(o + 1, hi);
+		}
+		else {
+			_mm_storeu_si128(o, _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi, zero));
+		}
+	}
+	return i + widen_ascii_scalar(in + i, n - i, out + i);
+}
+
+auto narrow_ascii_sse2(const wchar_t* in, size_t n, char* out) -> size_t
+{
+	auto i = size_t(0);
+	if constexpr (sizeof(wchar_t) == 4) {
+		auto non_ascii = _mm_set1_epi32(~0x7F);
+		auto zero = _mm_setzero_si128();
+		for (; n - i >= 16; i += 16) {
+			auto p = reinterpret_cast<const __m128i*>(in + i);
+			auto a = _mm_loadu_si128(p);
+			auto b = _mm_loadu_si128(p + 1);
+			auto c = _mm_loadu_si128(p + 2);
+			auto d = _mm_loadu_si128(p + 3);
+			auto all = _mm_or_si128(_mm_or_si128(a, b),
+			                        _mm_or_si128(c, d));
+			all = _mm_and_si128(all, non_ascii);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(all, zero)) !=
+			    0xFFFF)
+				break;
+			auto ab = _mm_packs_epi32(a, b);
+			auto cd = _mm_packs_epi32(c, d);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+			                 _mm_packus_epi16(ab, cd));
+		}
+	}
+	return i + narrow_ascii_scalar(in + i, n - i, out + i);
+}
+#endif
+
+#if NUSPELL_AVX2_DISPATCH
+__attribute__((target("avx2"))) auto
+widen_ascii_avx2(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	auto i = size_t(0);
+	for (; n - i >= 32; i += 32) {
+		auto v = _mm256_loadu_si256(
+		    reinterpret_cast<const __m256i*>(in + i));
+		if (_mm256_movemask_epi8(v))
+			break;
+		auto o = reinterpret_cast<__m256i*>(out + i);
+		if constexpr (sizeof(wchar_t) == 2) {
+			auto lo = _mm256_castsi256_si128(v);
+			auto hi = _mm256_extracti128_si256(v, 1);
+			_mm256_storeu_si256(o, _mm256_cvtepu8_epi16(lo));
+			_mm256_storeu_si256(o + 1, _mm256_cvtepu8_epi16(hi));
+		}
+		else {
+			for (auto k = 0; k != 4; ++k) {
+				auto q = _mm_loadl_epi64(
+				    reinterpret_cast<const __m128i*>(in + i +
+				                                     8 * k));
+				_mm256_storeu_si256(o + k,
+				                    _mm256_cvtepu8_epi32(q));
+			}
+		}
+	}
+	return i + widen_ascii_sse2(in + i, n - i, out + i);
+}
+
+__attribute__((target("avx2"))) auto
+narrow_ascii_avx2(const wchar_t* in, size_t n, char* out) -> size_t
+{
+	auto i = size_t(0);
+	if constexpr (sizeof(wchar_t) == 4) {
+		auto non_ascii = _mm256_set1_epi32(~0x7F);
+		auto order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		for (; n - i >= 32; i += 32) {
+			auto p = reinterpret_cast<const __m256i*>(in + i);
+			auto a = _mm256_loadu_si256(p);
+			auto b = _mm256_loadu_si256(p + 1);
+			auto c = _mm256_loadu_si256(p + 2);
+			auto d = _mm256_loadu_si256(p + 3);
+			auto all = _mm256_or_si256(_mm256_or_si256(a, b),
+			                           _mm256_or_si256(c, d));
+			if (!_mm256_testz_si256(all, non_ascii))
+				break;
+			auto ab = _mm256_packs_epi32(a, b);
+			auto cd = _mm256_packs_epi32(c, d);
+			auto bytes = _mm256_packus_epi16(ab, cd);
+			bytes = _mm256_permutevar8x32_epi32(bytes, order);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+			                    bytes);
+		}
+	}
+	return i + narrow_ascii_sse2(in + i, n - i, out + i);
+}
+#endif
+
+using Widen_Ascii = size_t (*)(const char*, size_t, wchar_t*);
+using Narrow_Ascii = size_t (*)(const wchar_t*, size_t, char*);
+
+auto select_widen_ascii() -> Widen_Ascii
+{
+#if NUSPELL_AVX2_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return widen_ascii_avx2;
+#endif
+#if NUSPELL_SSE2
+	return widen_ascii_sse2;
 #else
-	// TODO: remove the ifdefs once we move to char32_t
-	// This is needed for Windows, as there, wchar_t strings are UTF-16 and
-	// in our suggestion routines, where we operate on single wchar_t values
-	// (code units), we can easlt get faulty surrogate pair.
-	// On Linux where wchar_t is UTF-32, a single code unit (single wchar_t
-	// value) is also a code point and there (on Linux) we can assume all
-	// wchar_t strings are always valid.
-	utf_to_utf_my(in, out);
+	return widen_ascii_scalar;
+#endif
+}
+
+auto select_narrow_ascii() -> Narrow_Ascii
+{
+#if NUSPELL_AVX2_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return narrow_ascii_avx2;
+#endif
+#if NUSPELL_SSE2
+	return narrow_ascii_sse2;
+#else
+	return narrow_ascii_scalar;
 #endif
 }
+
+// Most words are shorter than a vector, for them the indirect call does not
+// pay off. The kernel is chosen on first use, not during static
+// initialization, so the conversions work in static initializers of other
+// translation units too.
+auto widen_ascii(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	if (n < 16)
+		return widen_ascii_scalar(in, n, out);
+	static const auto vector_kernel = select_widen_ascii();
+	return vector_kernel(in, n, out);
+}
+
+auto narrow_ascii(const wchar_t* in, size_t n, char* out) -> size_t
+{
+	if (n < 16)
+		return narrow_ascii_scalar(in, n, out);
+	static const auto vector_kernel = select_narrow_ascii();
+	return vector_kernel(in, n, out);
+}
+} // namespace
+
+auto wide_to_utf8(const std::wstring& in, std::string& out) -> void
+{
+	out.clear();
+	append_wide_to_utf8(in, out);
+}
 auto wide_to_utf8(const std::wstring& in) -> std::string
 {
 	auto out = string();
@@ -177,14 +401,74 @@ auto wide_to_utf8(const std::wstring& in) -> std::string
 	return out;
 }
 
-auto utf8_to_wide(const std::string& in, std::wstring& out) -> bool
+/**
+ * @brief Appends the UTF-8 encoding of @p in to @p out.
+ */
+auto append_wide_to_utf8(std::wstring_view in, std::string& out) -> void
 {
-	return utf_to_utf_my(in, out);
+	using namespace boost::locale::utf;
+	auto base = out.size();
+	out.resize(base + in.size());
+	auto n = narrow_ascii(in.data(), in.size(), &out[base]);
+	if (n == in.size())
+		return;
+
+	// On Windows wchar_t strings are UTF-16 and in our suggestion routines,
+	// where we operate on single wchar_t values (code units), we can easily
+	// get a faulty surrogate pair. Such code units are replaced.
+	out.resize(base + n + (in.size() - n) * 4);
+	auto it = in.data() + n;
+	auto last = in.data() + in.size();
+	auto out_it = &out[base + n];
+	while (it != last) {
+		auto cp = utf_traits<wchar_t>::decode(it, last);
+		if (unlikely(cp == incomplete || cp == illegal))
+			cp = 0xFFFD;
+		out_it = utf_traits<char>::encode(cp, out_it);
+		auto k = narrow_ascii(it, last - it, out_it);
+		it += k;
+		out_it += k;
+	}
+	out.erase(out_it - out.data());
 }
-auto utf8_to_wide(const std::string& in) -> std::wstring
+
+/**
+ * @brief Converts UTF-8 to wide string.
+ *
+ * Runs of ASCII are converted in blocks, the other code points one by one.
+ * Invalid sequences are replaced with U+FFFD.
+ *
+ * @return false if @p in is not valid UTF-8.
+ */
+auto utf8_to_wide(std::string_view in, std::wstring& out) -> bool
+{
+	using namespace boost::locale::utf;
+	// Never more code units than bytes, even for UTF-16 wchar_t.
+	out.resize(in.size());
+	auto it = in.data();
+	auto last = in.data() + in.size();
+	auto out_it = &out[0];
+	auto valid = true;
+	for (;;) {
+		auto n = widen_ascii(it, last - it, out_it);
+		it += n;
+		out_it += n;
+		if (it == last)
+			break;
+		auto cp = utf_traits<char>::decode(it, last);
+		if (unlikely(cp == incomplete || cp == illegal)) {
+			valid = false;
+			cp = 0xFFFD;
+		}
+		out_it = utf_traits<wchar_t>::encode(cp, out_it);
+	}
+	out.erase(out_it - out.data());
+	return valid;
+}
+auto utf8_to_wide(std::string_view in) -> std::wstring
 {
 	auto out = wstring();
-	utf_to_utf_my(in, out);
+	utf8_to_wide(in, out);
 	return out;
 }
 
@@ -200,11 +484,6 @@ bool utf8_to_16(const std::string& in, std::u16string& out)
 	return utf_to_utf_my(in, out);
 }
 
-auto static is_ascii(char c) -> bool
-{
-	return static_cast<unsigned char>(c) <= 127;
-}
-
 auto is_all_ascii(const std::string& s) -> bool
 {
 	return all_of(begin(s), end(s), is_ascii);
@@ -236,7 +515,7 @@ auto is_all_bmp(const std::u16string& s) -> bool
 	return none_of(begin(s), end(s), is_surrogate_pair);
 }
 
-auto to_wide(const std::string& in, const std::locale& loc, std::wstring& out)
+auto to_wide(std::string_view in, const std::locale& loc, std::wstring& out)
     -> bool
 {
 	auto& cvt = use_facet<codecvt<wchar_t, char, mbstate_t>>(loc);
@@ -282,7 +561,7 @@ auto to_wide(const std::string& in, const std::locale& loc, std::wstring& out)
 	return valid;
 }
 
-auto to_wide(const std::string& in, const std::locale& loc) -> std::wstring
+auto to_wide(std::string_view in, const std::locale& loc) -> std::wstring
 {
 	auto ret = wstring();
 	to_wide(in, loc, ret);
@@ -387,6 +666,141 @@ auto static icu_to_wide(const icu::UnicodeString& in, std::wstring& out) -> bool
 #endif
 }
 
+namespace {
+/**
+ * @brief Simple case mappings of the Latin letters, taken once from ICU.
+ *
+ * The mappings of the strings made only of these characters are done without
+ * ICU when the locale has no casing rules of its own. Characters whose full
+ * mapping is not a single character, e.g. sharp s, are left to ICU.
+ */
+class Latin_Case_Table {
+	struct Entry {
+		wchar_t lower = 0;
+		wchar_t upper = 0;
+		wchar_t title = 0;
+		bool simple = false;
+		bool word_letter = false;
+	};
+	static constexpr size_t size = 0x250;
+	array<Entry, size> table;
+
+	auto is_simple(wchar_t c) const -> bool
+	{
+		auto u = static_cast<make_unsigned_t<wchar_t>>(c);
+		return u < size && table[u].simple;
+	}
+	auto entry(wchar_t c) const -> const Entry&
+	{
+		return table[static_cast<make_unsigned_t<wchar_t>>(c)];
+	}
+	auto all_simple(wstring_view s) const -> bool
+	{
+		return all_of(begin(s), end(s),
+		              [&](wchar_t c) { return is_simple(c); });
+	}
+
+      public:
+	Latin_Case_Table()
+	{
+		auto& root = icu::Locale::getRoot();
+		for (UChar32 c = 0; c != size; ++c) {
+			auto& e = table[c];
+			e.lower = u_tolower(c);
+			e.upper = u_toupper(c);
+			e.title = u_totitle(c);
+			auto l = icu::UnicodeString(c);
+			auto u = l;
+			auto t = l;
+			l.toLower(root);
+			u.toUpper(root);
+			t.toTitle(nullptr, root);
+			e.simple = l == icu::UnicodeString(UChar32(e.lower)) &&
+			           u == icu::UnicodeString(UChar32(e.upper)) &&
+			           t == icu::UnicodeString(UChar32(e.title));
+			e.word_letter =
+			    u_getIntPropertyValue(c, UCHAR_WORD_BREAK) ==
+			    U_WB_ALETTER;
+		}
+	}
+
+	/**
+	 * @brief Tells if the locale has casing rules of its own, like the
+	 * dotted i in Turkish or the IJ digraph in Dutch.
+	 */
+	static auto has_special_casing(const icu::Locale& loc) -> bool
+	{
+		auto lang = string_view(loc.getLanguage());
+		return lang == "tr" || lang == "az" || lang == "lt" ||
+		       lang == "nl";
+	}
+
+	auto to_lower(wstring_view in, const icu::Locale& loc,
+	              wstring& out) const -> bool
+	{
+		if (!all_simple(in) || has_special_casing(loc))
+			return false;
+		out.assign(in);
+		for (auto& c : out)
+			c = entry(c).lower;
+		return true;
+	}
+	auto to_upper(wstring_view in, const icu::Locale& loc,
+	              wstring& out) const -> bool
+	{
+		if (!all_simple(in) || has_special_casing(loc))
+			return false;
+		out.assign(in);
+		for (auto& c : out)
+			c = entry(c).upper;
+		return true;
+	}
+	auto to_title(wstring_view in, const icu::Locale& loc,
+	              wstring& out) const -> bool
+	{
+		// A string of letters is one word, its first letter is
+		// titlecased only if it is cased.
+		if (in.empty() || !all_simple(in) || has_special_casing(loc))
+			return false;
+		auto is_word_letter = [&](wchar_t c) {
+			return entry(c).word_letter;
+		};
+		if (!all_of(begin(in), end(in), is_word_letter))
+			return false;
+		auto& first = entry(in[0]);
+		if (first.lower == first.upper)
+			return false;
+		out.assign(in);
+		out[0] = first.title;
+		for (auto i = size_t(1); i != out.size(); ++i)
+			out[i] = entry(out[i]).lower;
+		return true;
+	}
+	auto to_lower_char_at(wstring& s, size_t i,
+	                      const icu::Locale& loc) const -> bool
+	{
+		if (!is_simple(s[i]) || has_special_casing(loc))
+			return false;
+		s[i] = entry(s[i]).lower;
+		return true;
+	}
+	auto to_title_char_at(wstring& s, size_t i,
+	                      const icu::Locale& loc) const -> bool
+	{
+		if (!is_simple(s[i]) || has_special_casing(loc))
+			return false;
+		s[i] = entry(s[i]).title;
+		return true;
+	}
+};
+
+auto latin_case_table() -> const Latin_Case_Table&
+{
+	static const auto table = Latin_Case_Table();
+	return table;
+}
+} // namespace
+
 auto to_upper(wstring_view in, const icu::Locale& loc) -> std::wstring
 {
 	auto out = wstring();
@@ -408,18 +822,24 @@ auto to_lower(wstring_view in, const icu::Locale& loc) -> std::wstring
 
 auto to_upper(wstring_view in, const icu::Locale& loc, wstring& out) -> void
 {
+	if (latin_case_table().to_upper(in, loc, out))
+		return;
 	auto us = wide_to_icu(in);
 	us.toUpper(loc);
 	icu_to_wide(us, out);
 }
 auto to_title(wstring_view in, const icu::Locale& loc, wstring& out) -> void
 {
+	if (latin_case_table().to_title(in, loc, out))
+		return;
 	auto us = wide_to_icu(in);
 	us.toTitle(nullptr, loc);
 	icu_to_wide(us, out);
 }
 auto to_lower(wstring_view in, const icu::Locale& loc, wstring& out) -> void
 {
+	if (latin_case_table().to_lower(in, loc, out))
+		return;
 	auto us = wide_to_icu(in);
 	us.toLower(loc);
 	icu_to_wide(us, out);
@@ -427,6 +847,8 @@ auto to_lower(wstring_view in, const icu::Locale& loc, wstring& out) -> void
 
 auto to_lower_char_at(std::wstring& s, size_t i, const icu::Locale& loc) -> void
 {
+	if (latin_case_table().to_lower_char_at(s, i, loc))
+		return;
 	auto us = icu::UnicodeString(UChar32(s[i]));
 	us.toLower(loc);
 	if (likely(us.length() == 1)) {
@@ -439,6 +861,8 @@ auto to_lower_char_at(std::wstring& s, size_t i, const icu::Locale& loc) -> void
 }
 auto to_title_char_at(std::wstring& s, size_t i, const icu::Locale& loc) -> void
 {
+	if (latin_case_table().to_title_char_at(s, i, loc))
+		return;
 	auto us = icu::UnicodeString(UChar32(s[i]));
 	us.toTitle(nullptr, loc);
 	if (likely(us.length() == 1)) {
@@ -513,10 +937,372 @@ auto has_uppercase_at_compound_word_boundary(const std::wstring& word, size_t i)
 	return false;
 }
 
+/**
+ * @brief Builds the table for the characters of an alphabet.
+ *
+ * The case variants of the characters are added to the alphabet, so the table
+ * covers e.g. the upper case forms of a dictionary with only lower case words.
+ *
+ * @param alphabet the characters to put into the table, in any order.
+ * @param loc locale whose casing rules are applied.
+ */
+auto Case_Table::build(std::wstring_view alphabet, const icu::Locale& loc)
+    -> void
+{
+	auto chars = vector<UChar32>();
+	for (auto c : alphabet) {
+		auto u = UChar32(static_cast<make_unsigned_t<wchar_t>>(c));
+		if (u > 0x10FFFF || U_IS_SURROGATE(u))
+			continue;
+		chars.push_back(u);
+		chars.push_back(u_tolower(u));
+		chars.push_back(u_toupper(u));
+		chars.push_back(u_totitle(u));
+	}
+	sort(begin(chars), end(chars));
+	chars.erase(unique(begin(chars), end(chars)), end(chars));
+
+	auto bits = 4u;
+	while ((size_t(1) << bits) < 2 * chars.size())
+		++bits;
+	table.assign(size_t(1) << bits, Entry());
+	shift = 32 - bits;
+
+	auto lang = string_view(loc.getLanguage());
+	auto single = [](const icu::UnicodeString& us, wchar_t& out) {
+		if (us.countChar32() != 1)
+			return false;
+		auto c = us.char32At(0);
+		if (c > WCHAR_MAX)
+			return false;
+		out = c;
+		return true;
+	};
+	for (auto u : chars) {
+		if (u > WCHAR_MAX)
+			continue;
+		auto c = wchar_t(u);
+		auto mask = table.size() - 1;
+		auto i = size_t(uint32_t(c) * uint32_t(0x9e3779b1) >> shift);
+		while (table[i].used)
+			i = (i + 1) & mask;
+		auto& e = table[i];
+		e.c = c;
+		e.used = true;
+		e.simple_lower = u_tolower(u);
+		e.simple_upper = u_toupper(u);
+
+		unsigned char flags = 0;
+		if (u_islower(u))
+			flags |= IS_LOWER;
+		if (u_isupper(u))
+			flags |= IS_UPPER;
+		if (u_hasBinaryProperty(u, UCHAR_CASED))
+			flags |= CASED;
+		if (u_getIntPropertyValue(u, UCHAR_WORD_BREAK) == U_WB_ALETTER)
+			flags |= WORD_LETTER;
+		auto l = icu::UnicodeString(u);
+		auto up = l;
+		auto t = l;
+		l.toLower(loc);
+		up.toUpper(loc);
+		t.toTitle(nullptr, loc);
+		if (single(l, e.lower))
+			flags |= LOWER_OK;
+		if (single(up, e.upper))
+			flags |= UPPER_OK;
+		if (single(t, e.title))
+			flags |= TITLE_OK;
+
+		// Mappings that depend on the neighbouring characters.
+		auto is_mark = u_charType(u) == U_NON_SPACING_MARK;
+		auto err = U_ZERO_ERROR;
+		auto is_greek = uscript_getScript(u, &err) == USCRIPT_GREEK;
+		if (u == 0x3A3) // final sigma
+			flags &= ~LOWER_OK;
+		if ((lang == "tr" || lang == "az") && u == 0x307)
+			flags &= ~(LOWER_OK | UPPER_OK | TITLE_OK);
+		if (lang == "lt" && is_mark)
+			flags &= ~(LOWER_OK | UPPER_OK | TITLE_OK);
+		if (lang == "el" && (is_mark || is_greek))
+			flags &= ~UPPER_OK;
+		if (lang == "nl" && (e.title == 'I' || e.title == 0xCD))
+			flags &= ~TITLE_OK; // IJ digraph
+		e.flags = flags;
+	}
+}
+
+auto Case_Table::size() const -> size_t
+{
+	return count_if(begin(table), end(table),
+	                [](auto& e) { return e.used; });
+}
+
+auto Case_Table::all_have(std::wstring_view s, unsigned char flag) const
+    -> bool
+{
+	for (auto c : s) {
+		auto e = find(c);
+		if (!e || !(e->flags & flag))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Same as nuspell::classify_casing(), with the lookups of the
+ * characters in the table.
+ */
+auto Case_Table::classify_casing(std::wstring_view s) const -> Casing
+{
+	size_t upper = 0;
+	size_t lower = 0;
+	auto first_capital = false;
+	for (size_t i = 0; i != s.size(); ++i) {
+		auto c = s[i];
+		auto is_upper = false;
+		auto is_lower = false;
+		if (auto e = find(c)) {
+			is_upper = e->flags & IS_UPPER;
+			is_lower = e->flags & IS_LOWER;
+		}
+		else {
+			is_upper = u_isupper(c);
+			is_lower = u_islower(c);
+		}
+		if (is_upper) {
+			upper++;
+			first_capital |= i == 0;
+		}
+		else if (is_lower) {
+			lower++;
+		}
+	}
+	if (upper == 0)
+		return Casing::SMALL;
+	if (first_capital && upper == 1)
+		return Casing::INIT_CAPITAL;
+	if (lower == 0)
+		return Casing::ALL_CAPITAL;
+	if (first_capital)
+		return Casing::PASCAL;
+	else
+		return Casing::CAMEL;
+}
+
+auto Case_Table::to_lower(std::wstring_view in, const icu::Locale& loc,
+                          std::wstring& out) const -> void
+{
+	if (!all_have(in, LOWER_OK)) {
+		nuspell::to_lower(in, loc, out);
+		return;
+	}
+	out.assign(in);
+	for (auto& c : out)
+		c = find(c)->lower;
+}
+
+auto Case_Table::to_upper(std::wstring_view in, const icu::Locale& loc,
+                          std::wstring& out) const -> void
+{
+	if (!all_have(in, UPPER_OK)) {
+		nuspell::to_upper(in, loc, out);
+		return;
+	}
+	out.assign(in);
+	for (auto& c : out)
+		c = find(c)->upper;
+}
+
+auto Case_Table::to_title(std::wstring_view in, const icu::Locale& loc,
+                          std::wstring& out) const -> void
+{
+	// A string of letters is one word. Its first letter is titlecased
+	// only if it is cased, the rest is lowercased.
+	auto first = in.empty() ? nullptr : find(in[0]);
+	auto simple = first && (first->flags & CASED) &&
+	              (first->flags & TITLE_OK) &&
+	              all_have(in, WORD_LETTER) &&
+	              all_have(in.substr(1), LOWER_OK);
+	if (!simple) {
+		nuspell::to_title(in, loc, out);
+		return;
+	}
+	out.assign(in);
+	out[0] = first->title;
+	for (size_t i = 1; i != out.size(); ++i)
+		out[i] = find(out[i])->lower;
+}
+
+auto Case_Table::to_lower_char_at(std::wstring& s, size_t i,
+                                  const icu::Locale& loc) const -> void
+{
+	auto e = find(s[i]);
+	if (e && (e->flags & LOWER_OK)) {
+		s[i] = e->lower;
+		return;
+	}
+	nuspell::to_lower_char_at(s, i, loc);
+}
+
+auto Case_Table::to_title_char_at(std::wstring& s, size_t i,
+                                  const icu::Locale& loc) const -> void
+{
+	auto e = find(s[i]);
+	if (e && (e->flags & TITLE_OK)) {
+		s[i] = e->title;
+		return;
+	}
+	nuspell::to_title_char_at(s, i, loc);
+}
+
+auto Case_Table::simple_upper(wchar_t c) const -> wchar_t
+{
+	if (auto e = find(c))
+		return e->simple_upper;
+	return u_toupper(c);
+}
+
+auto Case_Table::simple_lower(wchar_t c) const -> wchar_t
+{
+	if (auto e = find(c))
+		return e->simple_lower;
+	return u_tolower(c);
+}
+
+/**
+ * @brief Builds the tables from the codecvt facet of a locale.
+ *
+ * @return false if the encoding of the locale is not single-byte.
+ */
+auto Single_Byte_Codec::build(const std::locale& loc) -> bool
+{
+	clear();
+	auto& cvt = use_facet<codecvt<wchar_t, char, mbstate_t>>(loc);
+	if (cvt.always_noconv() || cvt.max_length() != 1)
+		return false;
+	decode_table.resize(256, UNMAPPED);
+	for (size_t i = 0; i != 256; ++i) {
+		auto b = char(i);
+		auto b_next = static_cast<const char*>(&b);
+		auto w = wchar_t();
+		auto w_next = &w;
+		auto state = mbstate_t();
+		auto err = cvt.in(state, &b, &b + 1, b_next, &w, &w + 1, w_next);
+		if (err == cvt.ok && w_next == &w + 1)
+			decode_table[i] = char32_t(w);
+	}
+	// Keep only the characters that the facet encodes back to their byte.
+	encode_low.assign(0x100, -1);
+	for (size_t i = 0; i != 256; ++i) {
+		if (decode_table[i] == UNMAPPED)
+			continue;
+		auto w = wchar_t(decode_table[i]);
+		auto w_next = static_cast<const wchar_t*>(&w);
+		auto b = char();
+		auto b_next = &b;
+		auto state = mbstate_t();
+		auto err = cvt.out(state, &w, &w + 1, w_next, &b, &b + 1, b_next);
+		if (err != cvt.ok || b_next != &b + 1 || b != char(i))
+			continue;
+		if (size_t(w) < encode_low.size())
+			encode_low[w] = short(i);
+		else
+			encode_high.emplace_back(w, b);
+	}
+	sort(begin(encode_high), end(encode_high));
+	return true;
+}
+
+/**
+ * @brief Builds the decoding table from an ICU converter.
+ *
+ * Encoding is not needed for dictionary files, so encode() of a codec built
+ * this way always fails.
+ *
+ * @return false if the encoding of the converter is not single-byte.
+ */
+auto Single_Byte_Codec::build(UConverter* cnv) -> bool
+{
+	clear();
+	if (!cnv || ucnv_getMaxCharSize(cnv) != 1)
+		return false;
+	decode_table.resize(256, UNMAPPED);
+	for (size_t i = 0; i != 256; ++i) {
+		auto b = char(i);
+		auto err = U_ZERO_ERROR;
+		auto us = icu::UnicodeString(&b, 1, cnv, err);
+		if (U_SUCCESS(err) && us.length() == 1 &&
+		    !U16_IS_SURROGATE(us[0]))
+			decode_table[i] = us[0];
+	}
+	return true;
+}
+
+auto Single_Byte_Codec::clear() -> void
+{
+	decode_table.clear();
+	encode_low.clear();
+	encode_high.clear();
+}
+
+/**
+ * @brief Decodes with the table.
+ *
+ * @return false if the table is empty or some byte in @p in has no mapping,
+ * in which case @p out has unspecified content.
+ */
+auto Single_Byte_Codec::decode(std::string_view in, std::wstring& out) const
+    -> bool
+{
+	if (decode_table.empty())
+		return false;
+	out.resize(in.size());
+	auto unmapped = char32_t();
+	for (size_t i = 0; i != in.size(); ++i) {
+		auto c = decode_table[static_cast<unsigned char>(in[i])];
+		out[i] = wchar_t(c);
+		unmapped |= c;
+	}
+	return !(unmapped & UNMAPPED);
+}
+
+/**
+ * @brief Encodes with the tables.
+ *
+ * @return false if the tables are empty or some character in @p in has no
+ * mapping, in which case @p out has unspecified content.
+ */
+auto Single_Byte_Codec::encode(std::wstring_view in, std::string& out) const
+    -> bool
+{
+	if (encode_low.empty())
+		return false;
+	out.resize(in.size());
+	for (size_t i = 0; i != in.size(); ++i) {
+		auto c = in[i];
+		if (size_t(c) < encode_low.size()) {
+			auto b = encode_low[c];
+			if (b < 0)
+				return false;
+			out[i] = char(b);
+			continue;
+		}
+		auto it = lower_bound(
+		    begin(encode_high), end(encode_high), c,
+		    [](auto& e, wchar_t x) { return e.first < x; });
+		if (it == end(encode_high) || it->first != c)
+			return false;
+		out[i] = it->second;
+	}
+	return true;
+}
+
 Encoding_Converter::Encoding_Converter(const char* enc)
 {
 	auto err = UErrorCode();
 	cnv = ucnv_open(enc, &err);
+	single_byte.build(cnv);
 }
 
 Encoding_Converter::~Encoding_Converter()
@@ -529,19 +1315,24 @@ Encoding_Converter::Encoding_Converter(const Encoding_Converter& other)
 {
 	auto err = UErrorCode();
 	cnv = ucnv_safeClone(other.cnv, nullptr, nullptr, &err);
+	single_byte = other.single_byte;
 }
 
 auto Encoding_Converter::operator=(const Encoding_Converter& other)
     -> Encoding_Converter&
 {
-	this->~Encoding_Converter();
+	if (cnv)
+		ucnv_close(cnv);
 	auto err = UErrorCode();
 	cnv = ucnv_safeClone(other.cnv, nullptr, nullptr, &err);
+	single_byte = other.single_byte;
 	return *this;
 }
 
 auto Encoding_Converter::to_wide(const string& in, wstring& out) -> bool
 {
+	if (single_byte.decode(in, out))
+		return true;
 	if (ucnv_getType(cnv) == UCNV_UTF8)
 		return utf8_to_wide(in, out);
 
@@ -620,4 +1411,85 @@ auto count_appereances_of(wstring_view haystack, wstring_view needles) -> size_t
 		return needles.find(c) != needles.npos;
 	});
 }
+
+Mapped_File::Mapped_File(const std::string& path)
+{
+#ifdef _POSIX_VERSION
+	auto fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return;
+	struct stat st;
+	if (fstat(fd, &st) == 0) {
+		sz = st.st_size;
+		mtime = st.st_mtime;
+		opened = true;
+		if (sz != 0) {
+			auto p = mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				ptr = static_cast<const char*>(p);
+				mapped = true;
+			}
+			else {
+				opened = false;
+			}
+		}
+	}
+	close(fd);
+#else
+	auto in = std::ifstream(path, std::ios_base::binary);
+	if (!in.is_open())
+		return;
+	in.seekg(0, in.end);
+	sz = in.tellg();
+	in.seekg(0, in.beg);
+	buffer.reset(new uint64_t[sz / sizeof(uint64_t) + 1]);
+	ptr = reinterpret_cast<const char*>(buffer.get());
+	opened = bool(in.read(reinterpret_cast<char*>(buffer.get()), sz));
+#endif
+}
+
+Mapped_File::~Mapped_File()
+{
+#ifdef _POSIX_VERSION
+	if (mapped)
+		munmap(const_cast<char*>(ptr), sz);
+#endif
+}
+
+/**
+ * @brief Returns a path next to @p path that no other thread or process of
+ * this program uses at the same time.
+ */
+auto unique_temp_path(const std::string& path) -> std::string
+{
+	static auto counter = atomic<unsigned long>();
+#ifdef _POSIX_VERSION
+	auto pid = static_cast<unsigned long>(getpid());
+#elif defined(_WIN32)
+	auto pid = static_cast<unsigned long>(_getpid());
+#else
+	auto pid = static_cast<unsigned long>(random_device()());
+#endif
+	return path + ".tmp" + to_string(pid) + '-' + to_string(counter++);
+}
+
+/**
+ * @brief Renames @p from to @p to, replacing the file at @p to.
+ *
+ * Where the platform allows it, the replacement is atomic, everyone who opens
+ * @p to sees either the old or the new file, and those who have the old file
+ * open or mapped keep it.
+ */
+auto replace_file(const std::string& from, const std::string& to) -> bool
+{
+#ifdef _POSIX_VERSION
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#elif defined(_WIN32)
+	return MoveFileExA(from.c_str(), to.c_str(),
+	                   MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	std::remove(to.c_str());
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
 } // namespace nuspell
@@ -25,9 +25,12 @@
 #define NUSPELL_UTILS_HXX
 
 #include <clocale>
+#include <cstdint>
 #include <locale>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) ||               \
@@ -57,9 +60,10 @@ auto split_on_any_of(const std::string& s, const char* sep,
 
 auto wide_to_utf8(const std::wstring& in, std::string& out) -> void;
 auto wide_to_utf8(const std::wstring& in) -> std::string;
+auto append_wide_to_utf8(std::wstring_view in, std::string& out) -> void;
 
-auto utf8_to_wide(const std::string& in, std::wstring& out) -> bool;
-auto utf8_to_wide(const std::string& in) -> std::wstring;
+auto utf8_to_wide(std::string_view in, std::wstring& out) -> bool;
+auto utf8_to_wide(std::string_view in) -> std::wstring;
 
 auto utf8_to_16(const std::string& in) -> std::u16string;
 auto utf8_to_16(const std::string& in, std::u16string& out) -> bool;
@@ -71,9 +75,9 @@ auto latin1_to_ucs2(const std::string& s, std::u16string& out) -> void;
 
 auto is_all_bmp(const std::u16string& s) -> bool;
 
-auto to_wide(const std::string& in, const std::locale& inloc, std::wstring& out)
+auto to_wide(std::string_view in, const std::locale& inloc, std::wstring& out)
     -> bool;
-auto to_wide(const std::string& in, const std::locale& inloc) -> std::wstring;
+auto to_wide(std::string_view in, const std::locale& inloc) -> std::wstring;
 auto to_narrow(const std::wstring& in, std::string& out,
                const std::locale& outloc) -> bool;
 auto to_narrow(const std::wstring& in, const std::locale& outloc)
@@ -117,8 +121,108 @@ auto classify_casing(std::wstring_view s) -> Casing;
 auto has_uppercase_at_compound_word_boundary(const std::wstring& word, size_t i)
     -> bool;
 
+/**
+ * @brief Case mappings of the characters of one dictionary in its locale.
+ *
+ * The table holds only the characters of the alphabet it was built for, with
+ * the casing rules of the locale applied. Strings with other characters, and
+ * characters whose mapping depends on their neighbours, are mapped with the
+ * free functions above.
+ */
+class Case_Table {
+	enum : unsigned char {
+		IS_LOWER = 1 << 0,
+		IS_UPPER = 1 << 1,
+		CASED = 1 << 2,
+		LOWER_OK = 1 << 3,
+		UPPER_OK = 1 << 4,
+		TITLE_OK = 1 << 5,
+		WORD_LETTER = 1 << 6
+	};
+	struct Entry {
+		wchar_t c = 0;
+		wchar_t lower = 0;
+		wchar_t upper = 0;
+		wchar_t title = 0;
+		wchar_t simple_lower = 0;
+		wchar_t simple_upper = 0;
+		bool used = false;
+		unsigned char flags = 0;
+	};
+	std::vector<Entry> table;
+	unsigned shift = 0;
+
+	auto find(wchar_t c) const -> const Entry*
+	{
+		if (table.empty())
+			return nullptr;
+		auto mask = table.size() - 1;
+		auto i = size_t(uint32_t(c) * uint32_t(0x9e3779b1) >> shift);
+		for (;; i = (i + 1) & mask) {
+			auto& e = table[i];
+			if (!e.used)
+				return nullptr;
+			if (e.c == c)
+				return &e;
+		}
+	}
+	auto all_have(std::wstring_view s, unsigned char flag) const -> bool;
+
+      public:
+	auto build(std::wstring_view alphabet, const icu::Locale& loc)
+	    -> void;
+	auto size() const -> size_t;
+	auto classify_casing(std::wstring_view s) const -> Casing;
+	auto to_lower(std::wstring_view in, const icu::Locale& loc,
+	              std::wstring& out) const -> void;
+	auto to_upper(std::wstring_view in, const icu::Locale& loc,
+	              std::wstring& out) const -> void;
+	auto to_title(std::wstring_view in, const icu::Locale& loc,
+	              std::wstring& out) const -> void;
+	auto to_lower_char_at(std::wstring& s, size_t i,
+	                      const icu::Locale& loc) const -> void;
+	auto to_title_char_at(std::wstring& s, size_t i,
+	                      const icu::Locale& loc) const -> void;
+
+	/**
+	 * @brief Simple, locale independent, upper case mapping like
+	 * u_toupper().
+	 */
+	auto simple_upper(wchar_t c) const -> wchar_t;
+
+	/**
+	 * @brief Simple, locale independent, lower case mapping like
+	 * u_tolower().
+	 */
+	auto simple_lower(wchar_t c) const -> wchar_t;
+};
+
+/**
+ * @brief Lookup tables of an encoding where every character is one byte.
+ *
+ * Decoding is one table lookup per byte and encoding one lookup per
+ * character. The tables are empty if the encoding is not single-byte, and
+ * bytes or characters without a mapping make decode() and encode() fail so
+ * that the caller can fall back to the general converter.
+ */
+class Single_Byte_Codec {
+	static constexpr auto UNMAPPED = char32_t(0x80000000);
+	std::vector<char32_t> decode_table;
+	std::vector<short> encode_low; // byte for each character below 0x100
+	std::vector<std::pair<wchar_t, char>> encode_high; // sorted
+
+      public:
+	auto build(const std::locale& loc) -> bool;
+	auto build(UConverter* cnv) -> bool;
+	auto clear() -> void;
+	auto empty() const -> bool { return decode_table.empty(); }
+	auto decode(std::string_view in, std::wstring& out) const -> bool;
+	auto encode(std::wstring_view in, std::string& out) const -> bool;
+};
+
 class Encoding_Converter {
 	UConverter* cnv = nullptr;
+	Single_Byte_Codec single_byte;
 
       public:
 	Encoding_Converter() = default;
@@ -130,15 +234,16 @@ class Encoding_Converter {
 	~Encoding_Converter();
 	Encoding_Converter(const Encoding_Converter& other);
 	Encoding_Converter(Encoding_Converter&& other) noexcept
+	    : cnv(other.cnv), single_byte(std::move(other.single_byte))
 	{
-		cnv = other.cnv;
-		cnv = nullptr;
+		other.cnv = nullptr;
 	}
 	auto operator=(const Encoding_Converter& other) -> Encoding_Converter&;
 	auto operator=(Encoding_Converter&& other) noexcept
 	    -> Encoding_Converter&
 	{
 		std::swap(cnv, other.cnv);
+		std::swap(single_byte, other.single_byte);
 		return *this;
 	}
 	auto to_wide(const std::string& in, std::wstring& out) -> bool;
@@ -214,6 +319,40 @@ auto inline ends_with(std::wstring_view haystack, std::wstring_view needle)
 	                        needle) == 0;
 }
 
+/**
+ * @brief Read-only contents of a whole file.
+ *
+ * The file is memory mapped on POSIX systems. Elsewhere it is read into an
+ * 8-byte aligned buffer.
+ */
+class Mapped_File {
+	const char* ptr = nullptr;
+	size_t sz = 0;
+	int64_t mtime = 0;
+	bool opened = false;
+	bool mapped = false;
+	std::unique_ptr<uint64_t[]> buffer;
+
+      public:
+	Mapped_File() = default;
+	explicit Mapped_File(const std::string& path);
+	~Mapped_File();
+	Mapped_File(const Mapped_File&) = delete;
+	auto operator=(const Mapped_File&) -> Mapped_File& = delete;
+
+	auto is_open() const { return opened; }
+	auto data() const { return ptr; }
+	auto size() const { return sz; }
+	/**
+	 * @brief Last modification time in seconds since the epoch, 0 where
+	 * it is not available.
+	 */
+	auto modification_time() const { return mtime; }
+};
+
+auto unique_temp_path(const std::string& path) -> std::string;
+auto replace_file(const std::string& from, const std::string& to) -> bool;
+
 template <class T>
 auto begin_ptr(T& x)
 {
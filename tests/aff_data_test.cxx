@@ -43,6 +43,95 @@ TEST_CASE("class Encoding")
 	CHECK_FALSE(e.is_utf8());
 }
 
+TEST_CASE("class Word_List")
+{
+	auto w = Word_List();
+	auto word = wstring(L"table");
+	w.emplace(word, u"AB");
+	w.emplace(L"chair", u"");
+	w.emplace(L"book", u"BA");
+	word = L"xxxxx";
+	CHECK(w.size() == 3);
+	CHECK(w.equal_range(L"table").first->second ==
+	      w.equal_range(L"book").first->second);
+
+	auto copy = w;
+	w = Word_List();
+	auto r = copy.equal_range(L"table");
+	REQUIRE(r.second - r.first == 1);
+	CHECK(r.first->first == L"table");
+	CHECK(*r.first->second == u"AB");
+	CHECK(copy.equal_range(L"chair").first != nullptr);
+	CHECK(copy.equal_range(L"xxxxx").first == nullptr);
+
+	for (auto i = 0; i != 1000; ++i)
+		copy.emplace(to_wstring(i), u"");
+	auto found = 0;
+	auto rejected = 0;
+	for (auto i = 0; i != 2000; ++i) {
+		auto key = to_wstring(i);
+		found += copy.equal_range(key).first != nullptr;
+		rejected += !copy.may_contain(Word_List::hasher()(key));
+	}
+	CHECK(found == 1000);
+	CHECK(rejected > 900);
+}
+
+TEST_CASE("Word_List with UTF-8 storage")
+{
+	auto wide = Word_List();
+	auto w = Word_List();
+	w.set_utf8_storage(true);
+	CHECK(w.uses_utf8_storage());
+	auto words = {L"", L"table", L"tables", L"naïve", L"naïveté",
+	              L"\u0444\u0430", L"\U0001D538", L"\U0001D538bc"};
+	for (auto word : words) {
+		wide.emplace(word, u"A");
+		w.emplace(word, u"A");
+	}
+	CHECK(w.size() == words.size());
+	auto buffer = wstring();
+	for (auto word : words) {
+		auto r = w.equal_range(word);
+		REQUIRE(r.second - r.first == 1);
+		CHECK(r.first->first.is_utf8());
+		CHECK(r.first->first == word);
+		CHECK(r.first->first.to_wide(buffer) == word);
+		CHECK(Word_List::hasher()(r.first->first) ==
+		      Word_List::hasher()(word));
+	}
+	CHECK(w.equal_range(L"naïv").first == nullptr);
+	CHECK(w.equal_range(L"naïvE").first == nullptr);
+
+	wide.build_prefix_index();
+	w.build_prefix_index();
+	REQUIRE(w.has_prefix_index());
+	for (auto str : {L"", L"x", L"ta", L"tablesx", L"naïvetés",
+	                 L"\u0444\u0430\u0444", L"\U0001D539",
+	                 L"\U0001D538bcd"}) {
+		auto a = wide.match_prefixes(str);
+		auto b = w.match_prefixes(str);
+		CHECK(a.depth == b.depth);
+		CHECK(a.word_ends == b.word_ends);
+	}
+
+	// not valid Unicode, kept as wchar_t
+	auto invalid = wstring{L'a', wchar_t(0xD800)};
+	w.emplace(invalid, u"");
+	auto r = w.equal_range(invalid);
+	REQUIRE(r.first != r.second);
+	CHECK_FALSE(r.first->first.is_utf8());
+	w.build_prefix_index();
+	CHECK_FALSE(w.has_prefix_index());
+
+	auto copy = w;
+	CHECK(copy.uses_utf8_storage());
+	CHECK(copy.size() == w.size());
+	for (auto word : words)
+		CHECK(copy.equal_range(word).first != nullptr);
+	CHECK(copy.equal_range(invalid).first != nullptr);
+}
+
 TEST_CASE("Aff_Data::parse() error 1")
 {
 	auto cerr_buf = stringbuf();
@@ -180,3 +269,113 @@ SFX խխ 	0	ագ	.
 
 	cerr.rdbuf(old);
 }
+
+TEST_CASE("Aff_Data::parse() long flags are renumbered")
+{
+	auto aff = istringstream(R"(
+FLAG long
+FORBIDDENWORD zz
+SFX Aa Y 1
+SFX Aa 0 s/Bb .
+SFX Bb Y 1
+SFX Bb 0 t .
+)");
+	auto dic = istringstream("2\nfoo/AaBb\nbar/AaYy\n");
+	auto d = Aff_Data();
+	REQUIRE(d.parse_aff_dic(aff, dic));
+	CHECK(d.forbiddenword_flag < 256);
+	CHECK(d.forbiddenword_flag != d.suffixes.begin()->flag);
+	for (auto& s : d.suffixes) {
+		CHECK(s.flag < 256);
+		CHECK(s.cont_flags.size() <= 1);
+	}
+	auto foo = d.words.equal_range(L"foo").first;
+	auto bar = d.words.equal_range(L"bar").first;
+	REQUIRE(foo);
+	REQUIRE(bar);
+	CHECK(foo->second->size() == 2);
+	CHECK(bar->second->size() == 2);
+	CHECK_FALSE(bar->second->contains(d.forbiddenword_flag));
+}
+
+TEST_CASE("Aff_Data::compute_affix_properties()")
+{
+	auto aff_text = string(R"(
+NEEDAFFIX N
+CIRCUMFIX X
+ONLYINCOMPOUND O
+PFX A Y 1
+PFX A 0 re/N .
+SFX B Y 2
+SFX B 0 s/X .
+SFX B 0 ing/O .
+)");
+	auto aff = istringstream(aff_text);
+	auto d = Aff_Data();
+	REQUIRE(d.parse_aff(aff));
+	auto& pfx = *d.prefixes.begin();
+	CHECK(pfx.properties == 0);
+	d.compute_affix_properties();
+	CHECK(pfx.properties & NEEDS_AFFIX);
+	CHECK_FALSE(pfx.properties & IS_CIRCUMFIX);
+	CHECK_FALSE(pfx.properties & NOT_VALID << FULL_WORD);
+	CHECK(pfx.properties & NOT_VALID << AT_COMPOUND_END);
+
+	// no compounding, so the ONLYINCOMPOUND suffix is dropped
+	REQUIRE(distance(d.suffixes.begin(), d.suffixes.end()) == 1);
+	auto& sfx = *d.suffixes.begin();
+	CHECK(sfx.properties & IS_CIRCUMFIX);
+	CHECK(sfx.properties & NOT_VALID << AT_COMPOUND_BEGIN);
+	CHECK_FALSE(sfx.properties & NOT_VALID << AT_COMPOUND_END);
+
+	aff = istringstream(aff_text + "COMPOUNDFLAG C\n");
+	d = Aff_Data();
+	REQUIRE(d.parse_aff(aff));
+	CHECK(distance(d.suffixes.begin(), d.suffixes.end()) == 2);
+}
+
+TEST_CASE("Aff_Data::parse_dic() on multiple threads")
+{
+	auto aff_text = string("SFX A Y 1\nSFX A 0 s .\nFORBIDDENWORD F\n");
+	auto dic_text = string("40000\n");
+	for (auto i = 0; i != 40000; ++i) {
+		switch (i % 4) {
+		case 0:
+			dic_text += "word" + to_string(i) + "/A\n";
+			break;
+		case 1:
+			dic_text += "Word" + to_string(i % 100) + "/AF\n";
+			break;
+		case 2:
+			dic_text += "WoRd" + to_string(i % 100) + "\n";
+			break;
+		case 3:
+			dic_text += "word" + to_string(i % 10) + "/A\n";
+			break;
+		}
+	}
+	auto parse = [&](size_t num_threads) {
+		auto aff = istringstream(aff_text);
+		auto dic = istringstream(dic_text);
+		auto d = Aff_Data();
+		REQUIRE(d.parse_aff(aff));
+		REQUIRE(d.parse_dic(dic, num_threads));
+		return d;
+	};
+	auto d1 = parse(1);
+	auto d4 = parse(4);
+	CHECK(d1.words.size() == 50000);
+	CHECK(d1.words.uses_utf8_storage());
+	REQUIRE(d1.words.bucket_count() == d4.words.bucket_count());
+	auto same = true;
+	for (size_t i = 0; i != d1.words.bucket_count(); ++i) {
+		auto b1 = d1.words.bucket_data(i);
+		auto b4 = d4.words.bucket_data(i);
+		same &= equal(begin(b1), end(b1), begin(b4), end(b4),
+		              [](auto& a, auto& b) {
+			              return a.first == b.first &&
+			                     *a.second == *b.second;
+		              });
+	}
+	CHECK(same);
+}
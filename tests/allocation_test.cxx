@@ -0,0 +1,62 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <nuspell/dictionary.hxx>
+
+#include <catch2/catch.hpp>
+
+using namespace std;
+using namespace nuspell;
+
+// defined in counting_new.cxx
+auto allocation_count() -> size_t;
+
+struct Dict_Test : public nuspell::Dict_Base {
+	using Dict_Base::check_simple_word;
+};
+
+TEST_CASE("Dictionary::check_simple_word does not allocate", "[dictionary]")
+{
+	auto d = Dict_Test();
+
+	d.words.emplace(L"happy", u"UN");
+	d.words.emplace(L"try", u"S");
+	d.words.emplace(L"modification", u"V");
+	d.prefixes = {{u'U', true, L"", L"un", Flag_Set(), L"."}};
+	d.suffixes = {{u'N', true, L"y", L"iness", Flag_Set(u"S"), L"y"},
+	              {u'S', true, L"", L"es", Flag_Set(), L"."},
+	              {u'S', true, L"y", L"ies", Flag_Set(), L"y"},
+	              {u'V', true, L"ication", L"y", Flag_Set(), L"ication"}};
+	d.specialize_spelling();
+
+	auto words = vector<wstring>{
+	    L"happy",       L"unhappy", L"happiness", L"unhappiness",
+	    L"happinesses", L"tries",   L"untries",   L"unhappinessesx",
+	    L"modify",      wstring(170, 'a')};
+	auto expected = vector<bool>{true, true,  true,  true,  true,
+	                             true, false, false, true,  false};
+	auto results = vector<bool>();
+	results.reserve(words.size());
+
+	auto before = allocation_count();
+	for (auto& w : words)
+		results.push_back(d.check_simple_word(w) != nullptr);
+	auto after = allocation_count();
+	CHECK(results == expected);
+	CHECK(after == before);
+}
@@ -0,0 +1,41 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Global allocation functions that count the allocations, used by
+// allocation_test. They are kept alone in this file so that the compiler
+// never sees them together with the inlined allocations they serve.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::size_t num_allocations = 0;
+}
+
+auto allocation_count() -> std::size_t { return num_allocations; }
+
+auto operator new(std::size_t size) -> void*
+{
+	++num_allocations;
+	if (auto p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+auto operator delete(void* p) noexcept -> void { std::free(p); }
+auto operator delete(void* p, std::size_t) noexcept -> void { std::free(p); }
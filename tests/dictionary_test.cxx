@@ -20,6 +20,10 @@
 
 #include <catch2/catch.hpp>
 
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 using namespace std;
 using namespace nuspell;
 
@@ -33,6 +37,83 @@ TEST_CASE("Dictionary::load_from_path", "[dictionary]")
 	CHECK_THROWS_AS(Dictionary::load_from_path(""),
 	                Dictionary_Loading_Error);
 }
+namespace {
+// Spelled before main(), maybe before the statics of dictionary.cxx.
+const auto spelled_at_static_init = [] {
+	auto aff = istringstream("SET UTF-8\n");
+	auto dic = istringstream("1\nberry\n");
+	return Dictionary::load_from_aff_dic(aff, dic).spell("berry");
+}();
+} // namespace
+
+TEST_CASE("Dictionary::spell during static initialization", "[dictionary]")
+{
+	CHECK(spelled_at_static_init);
+}
+TEST_CASE("Dictionary::load_from_compiled", "[dictionary]")
+{
+	CHECK_THROWS_AS(Dictionary::load_from_compiled(""),
+	                Dictionary_Loading_Error);
+
+	auto aff = istringstream("SET UTF-8\nFLAG long\nSFX Zs Y 1\n"
+	                         "SFX Zs 0 s .\n");
+	auto dic = istringstream("4\nberry/Zs\nMay\nnuspell\nnaïve/Zs\n");
+	auto path = "dictionary_test_compiled.ndc";
+	{
+		auto out = ofstream(path, ios_base::binary);
+		Dictionary::compile_aff_dic(aff, dic, out);
+	}
+	auto d = Dictionary::load_from_compiled(path);
+	auto good = {"berry", "berrys", "May", "MAY", "nuspell", "naïves"};
+	for (auto& g : good)
+		CHECK(d.spell(g) == true);
+	auto wrong = {"Mays", "nuspells", "bery", "naïv"};
+	for (auto& w : wrong)
+		CHECK(d.spell(w) == false);
+
+	auto data = string();
+	{
+		auto f = ifstream(path, ios_base::binary);
+		data.assign(istreambuf_iterator<char>(f), {});
+	}
+	CHECK(Aff_Data::verify_compiled(data.data(), data.size()));
+	data.back() ^= 1;
+	CHECK_FALSE(Aff_Data::verify_compiled(data.data(), data.size()));
+
+	ofstream(path, ios_base::binary).write(data.data(), data.size() / 2);
+	CHECK_THROWS_AS(Dictionary::load_from_compiled(path),
+	                Dictionary_Loading_Error);
+	remove(path);
+}
+TEST_CASE("Dictionary::load_from_path_cached", "[dictionary]")
+{
+	auto base = string("dictionary_test_cached");
+	auto path = base + ".ndc";
+	ofstream(base + ".aff") << "SET UTF-8\n";
+	ofstream(base + ".dic") << "1\nberry\n";
+	auto d = Dictionary::load_from_path_cached(base, path);
+	CHECK(d.spell("berry"));
+	CHECK_FALSE(d.spell("nuspell"));
+	CHECK_NOTHROW(Dictionary::load_from_compiled(path));
+	CHECK_THROWS_AS(Dictionary::load_from_compiled(path, "other"),
+	                Dictionary_Loading_Error);
+
+	ofstream(base + ".dic") << "2\nberry\nnuspell\n";
+	CHECK_THROWS_AS(Dictionary::load_from_compiled(path),
+	                Dictionary_Loading_Error);
+	auto d2 = Dictionary::load_from_path_cached(base, path);
+	CHECK(d2.spell("nuspell"));
+	CHECK_NOTHROW(Dictionary::load_from_compiled(path, base));
+
+	// The file was replaced, not rewritten, d still reads the old one.
+	CHECK(d.spell("berry"));
+	CHECK_FALSE(d.spell("nuspell"));
+
+	remove((base + ".aff").c_str());
+	remove((base + ".dic").c_str());
+	CHECK_NOTHROW(Dictionary::load_from_compiled(path));
+	remove(path.c_str());
+}
 TEST_CASE("Dictionary::spell_priv simple", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -61,6 +142,7 @@ TEST_CASE("Dictionary::spell_priv suffixes", "[dictionary]")
 	d.words.emplace(L"vary", u"");
 
 	d.suffixes = {{u'T', true, L"y", L"ies", Flag_Set(), L".[^aeiou]y"}};
+	d.specialize_spelling();
 
 	auto good = {L"berry", L"Berry", L"berries", L"BERRIES",
 	             L"May",   L"MAY",   L"vary"};
@@ -79,6 +161,7 @@ TEST_CASE("Dictionary::spell_priv complex_prefixes", "[dictionary]")
 	d.words.emplace(L"drink", u"X");
 	d.suffixes = {{u'Y', true, L"", L"s", Flag_Set(), L"."},
 	              {u'X', true, L"", L"able", Flag_Set(u"Y"), L"."}};
+	d.specialize_spelling();
 
 	auto good = {L"drink", L"drinkable", L"drinkables"};
 	for (auto& g : good)
@@ -89,6 +172,26 @@ TEST_CASE("Dictionary::spell_priv complex_prefixes", "[dictionary]")
 		CHECK(d.spell_priv(w) == false);
 }
 
+TEST_CASE("Dictionary::spell_priv needaffix", "[dictionary]")
+{
+	auto d = Dict_Test();
+
+	d.need_affix_flag = u'N';
+	d.words.emplace(L"drink", u"NX");
+	d.words.emplace(L"walk", u"X");
+	d.suffixes = {{u'X', true, L"", L"able", Flag_Set(u"NY"), L"."},
+	              {u'Y', true, L"", L"s", Flag_Set(), L"."}};
+	d.specialize_spelling();
+
+	auto good = {L"walk", L"drinkables", L"walkables"};
+	for (auto& g : good)
+		CHECK(d.spell_priv(g) == true);
+
+	auto wrong = {L"drink", L"drinkable", L"walkable"};
+	for (auto& w : wrong)
+		CHECK(d.spell_priv(w) == false);
+}
+
 TEST_CASE("Dictionary::spell_priv extra_stripping", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -104,6 +207,7 @@ TEST_CASE("Dictionary::spell_priv extra_stripping", "[dictionary]")
 	              {u'Z', true, L"", L"3", Flag_Set(), L"1"}};
 	d.suffixes = {{u'C', true, L"", L"E", Flag_Set(), L"a"},
 	              {u'Y', true, L"", L"2", Flag_Set(u"Z"), L"b"}};
+	d.specialize_spelling();
 	// complex strip suffix prefix prefix
 	CHECK(d.spell_priv(L"QWaaE") == true);
 	// complex strip prefix suffix prefix
@@ -208,6 +312,143 @@ TEST_CASE("Dictionary::spell_priv compounding triple", "[dictionary]")
 		CHECK(d.spell_priv(w) == false);
 }
 
+TEST_CASE("Dictionary::spell_priv compounding long words", "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.compound_flag = 'C';
+	d.compound_min_length = 2;
+	d.words.emplace(L"aa", u"C");
+	d.words.emplace(L"aaa", u"C");
+	d.words.emplace(L"aaaa", u"C");
+
+	// without memoization of the tails these take exponential time
+	CHECK(d.spell_priv(std::wstring(64, 'a')) == true);
+	CHECK(d.spell_priv(std::wstring(64, 'a') + L'b') == false);
+	CHECK(d.spell_priv(L'b' + std::wstring(64, 'a')) == false);
+}
+
+TEST_CASE("Dictionary::set_max_work_steps", "[dictionary]")
+{
+	auto aff = std::istringstream("COMPOUNDFLAG C\nCOMPOUNDMIN 2\n");
+	auto dic = std::istringstream("3\naa/C\naaa/C\naaaa/C\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto word = std::string(40, 'a');
+
+	CHECK(d.spell(word) == true);
+	CHECK(d.last_call_truncated() == false);
+
+	d.set_max_work_steps(1);
+	CHECK(d.spell(word) == false);
+	CHECK(d.last_call_truncated() == true);
+	CHECK(d.spell("aaaa") == true);
+	CHECK(d.last_call_truncated() == false);
+
+	auto sugs = std::vector<std::string>();
+	d.suggest(word + 'b', sugs);
+	CHECK(d.last_call_truncated() == true);
+
+	// Calls that return early must not report the previous truncation.
+	CHECK(d.spell(word) == false);
+	CHECK(d.last_call_truncated() == true);
+	CHECK(d.spell(std::string(200, 'a')) == false);
+	CHECK(d.last_call_truncated() == false);
+	d.suggest(word + 'b', sugs);
+	CHECK(d.last_call_truncated() == true);
+	d.suggest(std::string(200, 'a'), sugs);
+	CHECK(d.last_call_truncated() == false);
+	CHECK(d.spell(word) == false);
+	CHECK(d.spell("\xFF") == false);
+	CHECK(d.last_call_truncated() == false);
+
+	d.set_max_work_steps(0);
+	CHECK(d.spell(word) == true);
+	CHECK(d.last_call_truncated() == false);
+}
+
+TEST_CASE("Dictionary::suggest into Suggestion_Buffer", "[dictionary]")
+{
+	auto aff = std::istringstream("TRY ae\n");
+	auto dic = std::istringstream("3\nmeat\nmate\ntame\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+
+	auto text = std::string("the meet is mate");
+	auto words = std::string_view(text);
+	CHECK(d.spell(words.substr(12)) == true);
+	CHECK(d.spell(words.substr(4, 4)) == false);
+
+	auto expected = std::vector<std::string>();
+	d.suggest(words.substr(4, 4), expected);
+	REQUIRE(expected.empty() == false);
+
+	auto buf = Suggestion_Buffer();
+	buf.push_back("stale");
+	d.suggest(words.substr(4, 4), buf);
+	REQUIRE(buf.size() == expected.size());
+	for (size_t i = 0; i != buf.size(); ++i)
+		CHECK(buf[i] == expected[i]);
+	CHECK(buf.end_offsets().back() == buf.data().size());
+
+	d.suggest(std::string(200, 'm'), buf);
+	CHECK(buf.empty());
+}
+
+TEST_CASE("Dictionary::spell and suggest overloads", "[dictionary]")
+{
+	auto aff = std::istringstream("TRY ae\n");
+	auto dic = std::istringstream("2\nmeat\nmäte\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+
+	auto word = std::string("meat");
+	CHECK(d.spell(word) == true);
+	CHECK(d.spell("meat") == true);
+	CHECK(d.spell(std::string_view(word)) == true);
+	CHECK(d.spell("meet") == false);
+
+	auto from_string = std::vector<std::string>();
+	auto from_literal = std::vector<std::string>();
+	d.suggest(std::string("mete"), from_string);
+	d.suggest("mete", from_literal);
+	CHECK(from_string.empty() == false);
+	CHECK(from_string == from_literal);
+
+	auto expected = std::vector<std::string>();
+	d.suggest("mate", expected);
+	REQUIRE(expected.empty() == false);
+	auto buf = Suggestion_Buffer();
+	d.suggest(std::string_view("mate"), buf);
+	REQUIRE(buf.size() == expected.size());
+	for (size_t i = 0; i != buf.size(); ++i)
+		CHECK(buf[i] == expected[i]);
+}
+
+TEST_CASE("Dictionary::specialize_spelling", "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.compound_flag = 'C';
+	d.checksharps = true;
+	d.words.emplace(L"goederen", u"C");
+	d.words.emplace(L"wagon", u"C");
+	d.words.emplace(L"straße", u"");
+
+	CHECK(d.spell_traits == d.GENERIC_SPELLING);
+	d.specialize_spelling();
+	CHECK(d.spell_traits == (d.COMPOUNDING | d.CHECKSHARPS));
+
+	auto good = {L"goederenwagon", L"STRASSE", L"Straße"};
+	for (auto& g : good)
+		CHECK(d.spell_priv(g) == true);
+	auto wrong = {L"goederenwagen", L"STRASE", L"Strasse"};
+	for (auto& w : wrong)
+		CHECK(d.spell_priv(w) == false);
+
+	d.compound_flag = 0;
+	d.checksharps = false;
+	d.complex_prefixes = true;
+	d.specialize_spelling();
+	CHECK(d.spell_traits == d.COMPLEX_PREFIXES);
+	CHECK(d.spell_priv(L"goederenwagon") == false);
+}
+
 TEST_CASE("Dictionary suggestions rep_suggest", "[dictionary]")
 {
 	auto d = Dict_Test();
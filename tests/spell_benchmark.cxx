@@ -0,0 +1,125 @@
+/* Copyright 2016-2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compares the generic spelling pipeline with the one specialized on the
+// traits of the dictionary, then times the compound search on long
+// pathological compounds. Run it as
+//     spell_benchmark tests/v1cmdline/*.dic
+
+#include <nuspell/dictionary.hxx>
+#include <nuspell/utils.hxx>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+using namespace nuspell;
+
+namespace {
+auto read_words(const string& path, vector<wstring>& out) -> void
+{
+	auto file = ifstream(path);
+	auto word = string();
+	auto wide_word = wstring();
+	while (file >> word) {
+		if (utf8_to_wide(word, wide_word))
+			out.push_back(wide_word);
+	}
+}
+
+auto time_spelling(const Dict_Base& d, const vector<wstring>& words,
+                   size_t repetitions) -> double
+{
+	auto best = chrono::steady_clock::duration::max();
+	auto word = wstring();
+	for (size_t i = 0; i != repetitions; ++i) {
+		auto start = chrono::steady_clock::now();
+		for (auto& w : words) {
+			word = w;
+			d.spell_priv(word);
+		}
+		best = min(best, chrono::steady_clock::now() - start);
+	}
+	auto ns = chrono::duration<double, nano>(best).count();
+	return ns / words.size();
+}
+
+// Every split of the word into parts of 2 to 4 letters is a valid compound,
+// except for the last letter, so the whole search space is explored.
+auto time_long_compounds() -> void
+{
+	auto d = Dict_Base();
+	d.compound_flag = 'C';
+	d.compound_min_length = 2;
+	d.words.emplace(L"aa", u"C");
+	d.words.emplace(L"aaa", u"C");
+	d.words.emplace(L"aaaa", u"C");
+	d.specialize_spelling();
+	for (size_t n : {16, 32, 64, 128}) {
+		auto words = vector<wstring>{wstring(n, 'a') + L'b'};
+		auto ns = time_spelling(d, words, 5);
+		cout << "compound of " << setw(3) << n + 1 << " letters"
+		     << setw(14) << ns << " ns\n";
+	}
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	const size_t repetitions = 200;
+	auto total_generic = 0.0;
+	auto total_specialized = 0.0;
+	cout << fixed << setprecision(1);
+	for (auto i = 1; i < argc; ++i) {
+		auto path = string(argv[i]);
+		if (path.size() < 4 || path.compare(path.size() - 4, 4, ".dic"))
+			continue;
+		path.erase(path.size() - 4);
+		auto aff = ifstream(path + ".aff");
+		auto dic = ifstream(path + ".dic");
+		auto d = Dict_Base();
+		if (!d.parse_aff_dic(aff, dic)) {
+			cerr << "Can not load " << path << '\n';
+			continue;
+		}
+		auto words = vector<wstring>();
+		read_words(path + ".good", words);
+		read_words(path + ".wrong", words);
+		if (words.empty())
+			continue;
+
+		// Both pipelines need the indexes built by specialize_spelling().
+		d.specialize_spelling();
+		auto traits = d.spell_traits;
+		d.spell_traits = Dict_Base::GENERIC_SPELLING;
+		auto generic = time_spelling(d, words, repetitions);
+		d.spell_traits = traits;
+		auto specialized = time_spelling(d, words, repetitions);
+		total_generic += generic;
+		total_specialized += specialized;
+		cout << setw(24) << left << path.substr(path.rfind('/') + 1)
+		     << right << " traits " << int(d.spell_traits) << setw(10)
+		     << generic << " ns" << setw(10) << specialized
+		     << " ns\n";
+	}
+	cout << "total generic " << total_generic << " ns, specialized "
+	     << total_specialized << " ns per word\n";
+	time_long_compounds();
+}
@@ -169,6 +169,30 @@ TEST_CASE("String_Set comparison", "[structures]")
 	CHECK(0 == ss3.count('z'));
 }
 
+TEST_CASE("String_Set::contains", "[structures]")
+{
+	auto ss = String_Set<char16_t>(u"a\u00FF\u0100\uFFFF");
+	CHECK(ss.contains(u'a'));
+	CHECK(ss.contains(u'\u00FF'));
+	CHECK(ss.contains(u'\u0100'));
+	CHECK(ss.contains(u'\uFFFF'));
+	CHECK_FALSE(ss.contains(u'b'));
+	CHECK_FALSE(ss.contains(0));
+	CHECK_FALSE(ss.contains(u'\u0101'));
+
+	ss.erase(u'a');
+	CHECK_FALSE(ss.contains(u'a'));
+	ss.insert(u'b');
+	CHECK(ss.contains(u'b'));
+	auto ss2 = String_Set<char16_t>(u"z");
+	ss.swap(ss2);
+	CHECK(ss.contains(u'z'));
+	CHECK_FALSE(ss.contains(u'b'));
+	CHECK(ss2.contains(u'b'));
+	ss2.clear();
+	CHECK_FALSE(ss2.contains(u'b'));
+}
+
 TEST_CASE("Substr_Replacer", "[structures]")
 {
 	using Substring_Replacer = Substr_Replacer<char>;
@@ -196,6 +220,99 @@ TEST_CASE("Break_Table", "[structures]")
 	a = d;
 }
 
+struct Extract_First {
+	auto& operator()(const pair<string, int>& p) const { return p.first; }
+};
+
+TEST_CASE("Hash_Multiset", "[structures]")
+{
+	auto h = Hash_Multiset<pair<string, int>, string, Extract_First>();
+	CHECK(h.empty());
+	CHECK(h.equal_range("abc").first == h.equal_range("abc").second);
+
+	for (int i = 0; i != 1000; ++i)
+		h.emplace(to_string(i), i);
+	h.emplace("7", -1);
+	h.emplace("500", -2);
+	h.emplace("7", -3);
+	CHECK(h.size() == 1003);
+
+	for (int i = 0; i != 1000; ++i) {
+		auto r = h.equal_range(to_string(i));
+		REQUIRE(r.second - r.first >= 1);
+		CHECK(r.first->first == to_string(i));
+		CHECK(r.first->second == i);
+	}
+	auto r = h.equal_range("7");
+	REQUIRE(r.second - r.first == 3);
+	CHECK(r.first[1].second == -1);
+	CHECK(r.first[2].second == -3);
+	r = h.equal_range("500");
+	REQUIRE(r.second - r.first == 2);
+	CHECK(r.first[1].second == -2);
+	r = h.equal_range("1000");
+	CHECK(r.first == r.second);
+
+	size_t n = 0;
+	for (size_t i = 0; i != h.bucket_count(); ++i)
+		n += h.bucket_data(i).size();
+	CHECK(n == h.size());
+}
+
+TEST_CASE("Polynomial_Hash", "[structures]")
+{
+	using H = Polynomial_Hash<wchar_t>;
+	CHECK(H::base * H::inverse_base == 1);
+	CHECK(H()(L"") == 0);
+	CHECK(H::hash(L"abcd") == H::append(H::hash(L"ab"), L"cd"));
+	CHECK(H()(L"abcd") != H()(L"abdc"));
+
+	auto h = H::hash(L"walked");
+	CHECK(H::replace_suffix(h, L"ed", L"") == H::hash(L"walk"));
+	CHECK(H::replace_suffix(h, L"ked", L"king") == H::hash(L"walking"));
+	CHECK(H::replace_suffix(h, L"walked", L"x") == H::hash(L"x"));
+	h = H::hash(L"unwalked");
+	CHECK(H::replace_prefix(h, L"un", L"", 6) == H::hash(L"walked"));
+	CHECK(H::replace_prefix(h, L"un", L"re", 6) == H::hash(L"rewalked"));
+	CHECK(H::replace_prefix(h, L"unwalked", L"", 0) == 0);
+}
+
+TEST_CASE("Bloom_Filter", "[structures]")
+{
+	auto f = Bloom_Filter();
+	CHECK_FALSE(f.may_contain(0));
+	f.reset(10000);
+	CHECK(f.capacity() == 10000);
+	auto hash = std::hash<string>();
+	for (auto i = 0; i != 10000; ++i)
+		f.insert(hash(to_string(i)));
+	auto all_found = true;
+	for (auto i = 0; i != 10000; ++i)
+		all_found &= f.may_contain(hash(to_string(i)));
+	CHECK(all_found);
+	auto false_positives = 0;
+	for (auto i = 10000; i != 20000; ++i)
+		false_positives += f.may_contain(hash(to_string(i)));
+	CHECK(false_positives < 200);
+
+	f.reset(10);
+	CHECK_FALSE(f.may_contain(hash("0")));
+}
+
+TEST_CASE("String_Arena", "[structures]")
+{
+	auto a = String_Arena<char>();
+	CHECK(a.store("").empty());
+	auto x = a.store("abc");
+	CHECK(x == "abc");
+	CHECK(a.store("").empty());
+	auto big = string(100000, 'x');
+	CHECK(a.store(big) == big);
+	CHECK(x == "abc");
+	a.clear();
+	CHECK(a.store("").empty());
+}
+
 TEST_CASE("Condition<char> 1", "[structures]")
 {
 	auto c1 = Condition<char>("");
@@ -287,6 +404,30 @@ TEST_CASE("Condition<wchar_t> with wildcards", "[structures]")
 	CHECK(true == c2.match_prefix(L"aba"));
 }
 
+TEST_CASE("Condition<wchar_t> with character sets", "[structures]")
+{
+	auto c1 = Condition<wchar_t>(L"[бвг]е[^aй]");
+	CHECK(true == c1.match_suffix(L"абеб"));
+	CHECK(true == c1.match_suffix(L"геб"));
+	CHECK(false == c1.match_suffix(L"деб"));
+	CHECK(false == c1.match_suffix(L"бей"));
+	CHECK(false == c1.match_suffix(L"беa"));
+	CHECK(false == c1.match_suffix(L"бе"));
+
+	// set wider than one bitmap window
+	auto c2 = Condition<wchar_t>(L"[a\u4e00][^b\u4e01]");
+	CHECK(true == c2.match_prefix(L"aa"));
+	CHECK(true == c2.match_prefix(L"\u4e00\u4e00"));
+	CHECK(false == c2.match_prefix(L"\u4e00\u4e01"));
+	CHECK(false == c2.match_prefix(L"ab"));
+	CHECK(false == c2.match_prefix(L"ca"));
+
+	c2 = L"x.";
+	CHECK(true == c2.match_prefix(L"xy"));
+	CHECK(false == c2.match_prefix(L"ay"));
+	CHECK(false == c2.match_prefix(L"x"));
+}
+
 TEST_CASE("Condition<wchar_t> exceptions", "[structures]")
 {
 	auto cond1 = L"]";
@@ -499,6 +640,57 @@ TEST_CASE("Suffix_Multiset")
 	REQUIRE(out == expected);
 }
 
+TEST_CASE("Prefix_Multiset many keys")
+{
+	auto keys = vector<wstring>();
+	for (auto a : {L'a', L'b', L'\u00E9', L'\u0436'})
+		for (auto b : {L'a', L'c', L'\u0436', L'\u4E2D'})
+			for (auto len = 0; len != 4; ++len)
+				keys.push_back(wstring(len, a) + b);
+	keys.push_back(L"");
+	keys.push_back(L"ab");
+	keys.push_back(L"a\U0001F600");
+	keys.push_back(L"\U0001F600\u4E2D");
+	auto set = Prefix_Multiset<wstring>(keys);
+	for (auto& word :
+	     {L"aaaac", L"ab", L"\u00E9\u00E9\u4E2D", L"\u0436\u0436", L"x",
+	      L"a\U0001F600b", L"\U0001F600\u4E2D\u4E2D", L"\u4E2E"}) {
+		auto expected = vector<wstring>();
+		for (auto& k : keys)
+			if (wstring_view(word).substr(0, k.size()) == k)
+				expected.push_back(k);
+		auto w = wstring(word);
+		auto it = set.iterate_prefixes_of(w);
+		auto out = vector<wstring>(begin(it), end(it));
+		auto by_size = [](auto& a, auto& b) {
+			return a.size() < b.size();
+		};
+		stable_sort(begin(expected), end(expected), by_size);
+		CHECK(out == expected);
+	}
+}
+
+TEST_CASE("Suffix_Table by continuation flag")
+{
+	auto table = Suffix_Table(vector<Suffix<wchar_t>>{
+	    {u'A', true, L"", L"s", Flag_Set(u"XY"), L"."},
+	    {u'B', true, L"", L"es", Flag_Set(u"Y"), L"."},
+	    {u'C', true, L"", L"s", Flag_Set(), L"."},
+	    {u'D', true, L"", L"ing", Flag_Set(u"X"), L"."}});
+	auto copy = table;
+	table = Suffix_Table();
+	auto word = wstring(L"boxes");
+	auto flags = u16string();
+	for (auto it = copy.iterate_suffixes_of(word, u'Y'); it; ++it)
+		flags += (*it)->flag;
+	CHECK(flags == u"AB");
+	flags.clear();
+	for (auto it = copy.iterate_suffixes_of(word, u'X'); it; ++it)
+		flags += (*it)->flag;
+	CHECK(flags == u"A");
+	CHECK_FALSE(copy.iterate_suffixes_of(word, u'Z'));
+}
+
 TEST_CASE("String_Pair", "[structures]")
 {
 	auto x = String_Pair<char>();
@@ -548,6 +740,62 @@ TEST_CASE("match_simple_regex", "[structures]")
 	CHECK_FALSE(match_simple_regex("qwerty"s, "abc?de*ff"s));
 }
 
+TEST_CASE("Compound_Rule_Table", "[structures]")
+{
+	// the first rule pushes the others past the first word of the state
+	auto long_rule = u""s;
+	for (auto i = 0; i != 70; ++i)
+		long_rule += u"b?";
+	auto rules = vector<u16string>{long_rule, u"abc?de*ff", u"x*y?f"};
+	auto table = Compound_Rule_Table(rules);
+	CHECK(table.state_size() == 2);
+
+	auto alphabet = u"abcdefxy"s;
+	auto flag_sets = vector<Flag_Set>();
+	for (auto c : alphabet)
+		flag_sets.emplace_back(u16string(1, c));
+	auto mismatches = 0;
+	auto data = vector<const Flag_Set*>();
+	auto flags = vector<size_t>();
+	// enumerates all words of up to 5 letters
+	for (;;) {
+		data.clear();
+		for (auto f : flags)
+			data.push_back(&flag_sets[f]);
+		auto expected = any_of(begin(rules), end(rules), [&](auto& r) {
+			return match_compund_rule(data, r);
+		});
+		mismatches += table.match_any_rule(data) != expected;
+
+		auto i = size_t(0);
+		auto last = alphabet.size() - 1;
+		for (; i != flags.size() && flags[i] == last; ++i)
+			flags[i] = 0;
+		if (i == 5)
+			break;
+		if (i == flags.size())
+			flags.push_back(0);
+		else
+			++flags[i];
+	}
+	CHECK(mismatches == 0);
+
+	// a word with several flags follows several rules at once
+	auto fx = Flag_Set(u"fx");
+	auto f = Flag_Set(u"f");
+	CHECK(table.match_any_rule({&fx, &fx, &f}));
+	CHECK(table.match_any_rule({&fx}));
+	CHECK_FALSE(table.match_any_rule({&f, &fx, &fx}));
+
+	auto state = vector<uint64_t>(table.state_size());
+	auto next = state;
+	table.initial_state(state.data());
+	CHECK(table.is_accepting(state.data()));
+	CHECK(table.advance(state.data(), Flag_Set(u"a"), next.data()));
+	CHECK_FALSE(table.is_accepting(next.data()));
+	CHECK_FALSE(table.advance(next.data(), Flag_Set(u"x"), state.data()));
+}
+
 TEST_CASE("List_Strings", "[structures]")
 {
 	auto l = List_Strings();
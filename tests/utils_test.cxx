@@ -20,6 +20,9 @@
 
 #include <boost/locale/utf8_codecvt.hpp>
 #include <catch2/catch.hpp>
+#include <unicode/uchar.h>
+#include <unicode/ucnv.h>
+#include <unicode/unistr.h>
 
 using namespace std;
 using namespace nuspell;
@@ -124,6 +127,51 @@ TEST_CASE("to_narrow", "[locale_utils]")
 	CHECK(all_of(begin(out), end(out), [](auto c) { return c == '?'; }));
 }
 
+TEST_CASE("Single_Byte_Codec", "[locale_utils]")
+{
+	auto codec = Single_Byte_Codec();
+	CHECK(codec.empty());
+	auto loc = locale(locale::classic(), new utf8_codecvt<wchar_t>());
+	CHECK_FALSE(codec.build(loc));
+	CHECK(codec.empty());
+
+	loc = locale(locale::classic(), new latin1_codecvt<wchar_t>());
+	REQUIRE(codec.build(loc));
+	auto all_bytes = string();
+	for (auto i = 0; i != 256; ++i)
+		all_bytes += char(i);
+	auto wide = wstring();
+	CHECK(codec.decode(all_bytes, wide));
+	CHECK(to_wide(all_bytes, loc) == wide);
+	auto narrow = string();
+	CHECK(codec.encode(wide, narrow));
+	CHECK(all_bytes == narrow);
+	CHECK_FALSE(codec.encode(L"abc\u0100", narrow));
+
+	auto cvt = Encoding_Converter("KOI8-R");
+	REQUIRE(cvt.valid());
+	auto cnv_codec = Single_Byte_Codec();
+	auto err = UErrorCode();
+	auto cnv = ucnv_open("KOI8-R", &err);
+	REQUIRE(cnv_codec.build(cnv));
+	CHECK(cnv_codec.decode(all_bytes, wide));
+	auto us = icu::UnicodeString(all_bytes.data(), 256, cnv, err);
+	ucnv_close(cnv);
+	CHECK(U_SUCCESS(err));
+	CHECK(wide.size() == 256);
+	for (size_t i = 0; i != wide.size(); ++i)
+		CHECK(wchar_t(us[i]) == wide[i]);
+	CHECK(wide == cvt.to_wide(all_bytes));
+	CHECK(L"\u0430\u0431\u0432" == cvt.to_wide("\xC1\xC2\xD7"));
+	CHECK_FALSE(cnv_codec.encode(L"abc", narrow));
+
+	err = UErrorCode();
+	cnv = ucnv_open("UTF-8", &err);
+	CHECK_FALSE(cnv_codec.build(cnv));
+	ucnv_close(cnv);
+	CHECK(cnv_codec.empty());
+}
+
 TEST_CASE("wide_to_utf8", "[locale_utils]")
 {
 	CHECK("abгшß" == wide_to_utf8(L"abгшß"));
@@ -147,6 +195,45 @@ TEST_CASE("wide_to_utf8", "[locale_utils]")
 	CHECK(exp == out);
 }
 
+namespace {
+// Converted before main(), maybe before the statics of utils.cxx.
+const auto wide_at_static_init = utf8_to_wide(string(40, 'a'));
+const auto narrow_at_static_init = wide_to_utf8(wstring(40, L'b'));
+} // namespace
+
+TEST_CASE("conversions during static initialization", "[locale_utils]")
+{
+	CHECK(wide_at_static_init == wstring(40, L'a'));
+	CHECK(narrow_at_static_init == string(40, 'b'));
+}
+
+TEST_CASE("utf8_to_wide", "[locale_utils]")
+{
+	CHECK(L"abгшß" == utf8_to_wide("abгшß"));
+	CHECK(L"\U0010FFFF ß" == utf8_to_wide("\U0010FFFF ß"));
+
+	// non-ASCII characters on every position around the block boundaries
+	auto out = wstring();
+	for (size_t i = 0; i != 70; ++i) {
+		auto in = string(70, 'a');
+		auto exp = wstring(70, L'a');
+		in.insert(i, "ĳ€\U0001F600");
+		exp.insert(i, L"ĳ€\U0001F600");
+		CHECK(utf8_to_wide(in, out) == true);
+		CHECK(exp == out);
+		CHECK(in == wide_to_utf8(out));
+
+		in = string(70, 'a');
+		exp = wstring(70, L'a');
+		in[i] = '\xFF';
+		exp[i] = L'\uFFFD';
+		CHECK(utf8_to_wide(in, out) == false);
+		CHECK(exp == out);
+	}
+	CHECK(utf8_to_wide("abc\xE2\x82", out) == false);
+	CHECK(L"abc\uFFFD" == out);
+}
+
 TEST_CASE("classify_casing", "[locale_utils]")
 {
 	CHECK(Casing::SMALL == classify_casing(L""));
@@ -329,6 +416,73 @@ TEST_CASE("to_title", "[locale_utils]")
 	CHECK(L"Ĳsselmeer" == to_title(L"ĲSSELMEER", l));
 }
 
+TEST_CASE("case mapping of Latin letters agrees with ICU", "[locale_utils]")
+{
+	auto icu_map = [](const wstring& in, auto f) {
+		auto us = icu::UnicodeString::fromUTF8(wide_to_utf8(in));
+		f(us);
+		auto out = string();
+		return utf8_to_wide(us.toUTF8String(out));
+	};
+	auto others = {L"", L"a", L"B", L"ß", L"'", L"1", L"ǅ", L"İ", L"ŉ"};
+	for (auto loc : {"en_US", "de_DE", "tr_TR", "nl_NL"}) {
+		auto l = icu::Locale(loc);
+		for (wchar_t c = 0; c != 0x250; ++c) {
+			for (auto o : others) {
+				auto w = wstring(1, c) + o + L'x';
+				CHECK(to_lower(w, l) == icu_map(w, [&](auto& us) {
+					      us.toLower(l);
+				      }));
+				CHECK(to_upper(w, l) == icu_map(w, [&](auto& us) {
+					      us.toUpper(l);
+				      }));
+				CHECK(to_title(w, l) == icu_map(w, [&](auto& us) {
+					      us.toTitle(nullptr, l);
+				      }));
+			}
+		}
+	}
+}
+
+TEST_CASE("Case_Table", "[locale_utils]")
+{
+	auto alphabet = wstring();
+	for (wchar_t c = 0x20; c != 0x400; ++c)
+		alphabet += c;
+	auto others = {L"",  L"a",     L"B",      L"ß",      L"'", L"1",
+	               L"j", L"\u0307", L"\u0301", L"\u03A3", L"ǅ"};
+	auto locales = {"en_US", "de_DE", "tr_TR", "lt_LT", "el_GR", "nl_NL"};
+	for (auto loc : locales) {
+		auto l = icu::Locale(loc);
+		auto t = Case_Table();
+		t.build(alphabet, l);
+		CHECK(t.size() >= alphabet.size());
+		for (auto c : alphabet) {
+			for (auto o : others) {
+				auto w = wstring(1, c) + o + L'x';
+				auto out = wstring();
+				t.to_lower(w, l, out);
+				CHECK(out == to_lower(w, l));
+				t.to_upper(w, l, out);
+				CHECK(out == to_upper(w, l));
+				t.to_title(w, l, out);
+				CHECK(out == to_title(w, l));
+				CHECK(t.classify_casing(w) ==
+				      classify_casing(w));
+			}
+			auto w = wstring(1, c);
+			auto expected = w;
+			t.to_lower_char_at(w, 0, l);
+			to_lower_char_at(expected, 0, l);
+			CHECK(w == expected);
+			t.to_title_char_at(w, 0, l);
+			to_title_char_at(expected, 0, l);
+			CHECK(w == expected);
+			CHECK(t.simple_upper(c) == wchar_t(u_toupper(c)));
+		}
+	}
+}
+
 TEST_CASE("split_on_any_of", "[string_utils]")
 {
 	auto in = string("^abc;.qwe/zxc/");
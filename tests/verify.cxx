@@ -292,6 +292,12 @@ auto normal_loop(istream& in, ostream& out, Dictionary& dic, Hunspell& hun,
 	out << "Duration Nuspell    " << duration_nu.count() << '\n';
 	out << "Duration Hunspell   " << duration_hun.count() << '\n';
 	out << "Speedup Rate        " << speedup << '\n';
+	if (NUSPELL_FILTER_STATS) {
+		auto& stats = Word_List::filter_stats();
+		out << "Filter Rejected     " << stats.rejected << '\n';
+		out << "Filter Found        " << stats.found << '\n';
+		out << "Filter False Pos.   " << stats.false_positives << '\n';
+	}
 }
 
 namespace std {
@@ -375,6 +381,7 @@ int main(int argc, char* argv[])
 	}
 	clog << "INFO: Pointed dictionary " << filename << ".{dic,aff}\n";
 	auto dic = Dictionary();
+	auto tick_a = chrono::high_resolution_clock::now();
 	try {
 		dic = Dictionary::load_from_path(filename);
 	}
@@ -386,7 +393,13 @@ int main(int argc, char* argv[])
 
 	auto aff_name = filename + ".aff";
 	auto dic_name = filename + ".dic";
+	auto tick_b = chrono::high_resolution_clock::now();
 	Hunspell hun(aff_name.c_str(), dic_name.c_str());
+	auto tick_c = chrono::high_resolution_clock::now();
+	auto load_nu = chrono::duration<double>(tick_b - tick_a).count();
+	auto load_hun = chrono::duration<double>(tick_c - tick_b).count();
+	clog << "INFO: Loading took " << load_nu << " s for Nuspell and "
+	     << load_hun << " s for Hunspell\n";
 	auto hun_loc = gen(
 	    "en_US." + Encoding(hun.get_dict_encoding()).value_or_default());
 